@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// spatially coherent run of Model::faces, culled as a whole before any vertex transform
+struct Cluster
+{
+    // faces [firstFace, firstFace + faceCount)
+    int firstFace, faceCount;
+    // vertices first referenced by this cluster, so every
+    // vertex is owned by exactly one cluster
+    int vertexBegin, vertexEnd;
+    // other clusters owning vertices this cluster references
+    std::vector<int> dependencies;
+    // bounding sphere in model space
+    glm::vec3 center;
+    float radius;
+    // face normals lie within acos(coneCutoff) of coneAxis,
+    // coneCutoff <= 0 if they span a hemisphere or more
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
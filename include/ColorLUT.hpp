@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "glm/glm.hpp"
+
+// 3D colour grading table loaded from a .cube file
+class ColorLUT
+{
+    public:
+        ColorLUT(const std::string& filename);
+        // c is display encoded and in [0, 1]
+        glm::vec3 apply(const glm::vec3 c) const;
+
+        bool isLoaded() const;
+
+    private:
+        glm::vec3 entry(const int r, const int g, const int b) const;
+
+        // red changes fastest
+        std::vector<glm::vec3> table;
+        glm::vec3 domainMin, domainMax;
+        int size;
+};
@@ -4,7 +4,8 @@
 
 struct Face
 {
-    Face(const glm::ivec3 v, const glm::ivec3 t, const glm::ivec3 n);
+    Face(const glm::ivec3 v);
 
-    glm::ivec3 vertices, uvs, normals;
+    // indices into the welded vertex attributes of Model
+    glm::ivec3 vertices;
 };
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Shading.hpp"
+
+// compile-time description of a fragment kernel, chosen once per frame
+template<Shading S, bool PerspectiveCorrection, bool NormalMap, bool EmissionMap,
+         bool Mipmapping>
+struct FragmentKernel
+{
+    static constexpr Shading shading = S;
+    static constexpr bool perspectiveCorrection = PerspectiveCorrection,
+        normalMap = NormalMap,
+        emissionMap = EmissionMap,
+        mipmapping = Mipmapping;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// 2.2 gamma conversions through precomputed tables
+class GammaTable
+{
+    public:
+        // 8 bit encoded value to 16 bit linear
+        static uint16_t Decode(const uint8_t c);
+        // linear value to 8 bit encoded, c is clamped to [0, 1]
+        static uint8_t Encode(const float c);
+        // the table behind Encode, for vectorized lookups
+        static const uint8_t* EncodeTable();
+
+        // the encode table is indexed by the top float bits,
+        // 256 entries per octave below 1
+        static constexpr int mantissaBits = 8,
+            octaves = 20,
+            firstIndex = (127 - octaves) << mantissaBits,
+            encodeSize = octaves << mantissaBits;
+
+    private:
+        struct Tables
+        {
+            uint16_t decode[256];
+            // padded so 32 bit gathers never read past the end
+            uint8_t encode[encodeSize + 3];
+
+            Tables();
+        };
+
+        static const Tables tables;
+};
+
+inline uint16_t GammaTable::Decode(const uint8_t c)
+{
+    return tables.decode[c];
+}
+
+inline const uint8_t* GammaTable::EncodeTable()
+{
+    return tables.encode;
+}
+
+inline uint8_t GammaTable::Encode(const float c)
+{
+    // below the first octave everything encodes to 0
+    if (!(c >= 1.0f / (1 << octaves)))
+    {
+        return 0;
+    }
+
+    if (c >= 1.0f)
+    {
+        return 255;
+    }
+
+    uint32_t bits;
+    std::memcpy(&bits, &c, sizeof(bits));
+
+    return tables.encode[(bits >> (23 - mantissaBits)) - firstIndex];
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// read-only memory mapping of a whole file
+class MappedFile
+{
+    public:
+        MappedFile(const std::string& filename);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool isOpen() const;
+        const char* getData() const;
+        size_t getSize() const;
+        // last write time in platform units, only compared for equality
+        uint64_t getModifiedTime() const;
+
+    private:
+        const char *data;
+        size_t size;
+        uint64_t modifiedTime;
+        // an empty file is open but has no mapping
+        bool open;
+#ifdef _WIN32
+        void *file, *mapping;
+#else
+        int fd;
+#endif
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "glm/glm.hpp"
+#include "glm/gtc/type_precision.hpp"
+#include "MipChain.hpp"
+#include "Texture.hpp"
+#include "NormalTexture.hpp"
+#include "MonoTexture.hpp"
+#include "ThreadPool.hpp"
+
+// every PBR input of one texel, so a fragment needs a single fetch
+struct alignas(16) MaterialTexel
+{
+    // linear, decoded once when the material is built
+    glm::u16vec3 albedo;
+    // octahedral encoding
+    glm::u16vec2 normal;
+    glm::u8vec3 emission;
+    uint8_t metallic, roughness, ao;
+};
+
+// decoded material with linear albedo, filtered like any other texel value
+struct MaterialSample
+{
+    glm::vec3 albedo, emission, normal;
+    float metallic, roughness, ao;
+
+    MaterialSample operator+(const MaterialSample& b) const;
+    MaterialSample operator-(const MaterialSample& b) const;
+    MaterialSample operator*(const float t) const;
+};
+
+class MaterialTexture
+{
+    public:
+        // resamples the inputs to the largest of their sizes
+        MaterialTexture(Texture& diffuse, NormalTexture& normal, MonoTexture& metallic,
+                        MonoTexture& roughness, MonoTexture& ao, Texture& emission,
+                        ThreadPool& pool);
+        MaterialSample getSample(float x, float y);
+        // trilinear, lod is log2 of the sample footprint in uv units
+        MaterialSample getSample(float x, float y, float lod);
+
+    private:
+        MaterialSample fetch(const size_t i) const;
+        static MaterialTexel average(const MaterialTexel& a, const MaterialTexel& b,
+                                     const MaterialTexel& c, const MaterialTexel& d);
+
+        // all mip levels
+        std::vector<MaterialTexel> texels;
+        MipChain mips;
+        unsigned width, height;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include "ThreadPool.hpp"
+
+class Model;
+
+// binary sidecar of a fully processed Model, so loading skips parsing, welding,
+// tangents and clustering. Arrays are stored in the in-memory layout, each
+// starting on a 64 byte boundary, and are read from a memory mapping.
+// With the compress flag the vertices and faces are stored by MeshCodec instead
+class MeshCache
+{
+    public:
+        // identifies the source file and the processing options,
+        // a cache written for a different stamp is stale
+        struct Stamp
+        {
+            uint64_t sourceSize, sourceTime;
+            uint32_t flags;
+        };
+
+        enum StampFlags
+        {
+            Optimized = 1,
+            Compressed = 2
+        };
+
+        // model<name>.obj -> model<name>.akgmesh
+        static std::string CacheFilename(const std::string& source);
+
+        // fills model, false if the cache is missing, stale or malformed
+        static bool Load(const std::string& filename, const Stamp& stamp, Model& model,
+                         ThreadPool& pool);
+        static bool Save(const std::string& filename, const Stamp& stamp, const Model& model);
+
+    private:
+        // vertices, normals, tangents, uvs, faces, clusters, dependencies,
+        // and the MeshCodec data replacing the first five when compressed
+        constexpr static int arrayCount = 8;
+
+        struct Header
+        {
+            char magic[8];
+            uint32_t version;
+            Stamp stamp;
+            int32_t vertexCount, faceCount, clusterCount, dependencyCount;
+            // 0 if the vertices and faces are stored as is
+            uint64_t encodedBytes;
+            uint64_t offsets[arrayCount];
+            uint64_t fileSize;
+        };
+
+        // Cluster with its dependencies moved to one shared array
+        struct ClusterRecord
+        {
+            int32_t firstFace, faceCount, vertexBegin, vertexEnd;
+            int32_t firstDependency, dependencyCount;
+            float center[3], radius, coneAxis[3], coneCutoff;
+        };
+
+        // fills the header's offsets and file size from its counts
+        static void layout(Header& header);
+        static size_t arrayBytes(const Header& header, const int array);
+
+        constexpr static uint32_t version = 2;
+        constexpr static size_t alignment = 64;
+};
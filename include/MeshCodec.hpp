@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "ThreadPool.hpp"
+
+class Model;
+
+// lossy compact encoding of a processed Model's vertices and faces.
+// Positions and uvs are quantized to 16 bits per component within their
+// bounding box, normals and tangents to 2x16 bit octahedral coordinates.
+// Face indices are coded per cluster as LEB128 varints of the distance back
+// from the cluster's next unused vertex, 0 being that vertex, which the
+// first use numbering of Model::buildClusters keeps small
+class MeshCodec
+{
+    public:
+        // false if the faces do not reference vertices in first use order
+        static bool Encode(const Model& model, std::vector<char>& data);
+        // fills the vertex attributes and faces, model.clusters must be set,
+        // false on malformed data
+        static bool Decode(const char* data, const size_t size, Model& model, ThreadPool& pool);
+
+    private:
+        struct Header
+        {
+            int32_t vertexCount, faceCount, clusterCount;
+            uint32_t indexBytes;
+            // value = offset + q * scale for a quantized component q
+            float positionOffset[3], positionScale[3];
+            float uvOffset[2], uvScale[2];
+        };
+
+        // sections after the header: positions, uvs, normals, tangents,
+        // cluster index stream starts, index stream
+        constexpr static int sectionCount = 6;
+
+        // fills offsets with each section's start, returns the total size
+        static size_t layout(const Header& header, size_t offsets[sectionCount]);
+
+        static void writeVarint(uint32_t v, std::vector<char>& out);
+
+        constexpr static int batchSize = 1 << 14;
+};
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include "ThreadPool.hpp"
+
+// placement of one level inside a texture's texel array
+struct MipLevel
+{
+    int width, height;
+    // texels in one row of tiles
+    size_t tileRowTexels, offset;
+};
+
+// box filtered levels stored back to back after the base image,
+// the texels themselves are owned by the texture.
+// Each level is split into 8x8 texel tiles stored row by row,
+// with the texels of a tile in Z-order, so a footprint that
+// moves along v stays in the same few cache lines
+class MipChain
+{
+    public:
+        // lays out the levels of a width x height image, returns the texel count
+        size_t Init(const int width, const int height);
+
+        // stores a row-major base image, convert maps a pixel index to a texel.
+        // Fill and Build split the rows over the pool when one is given
+        template<class T, class Convert>
+        void Fill(std::vector<T>& texels, Convert convert, ThreadPool* pool = nullptr) const;
+
+        // fills every level below the base one from the level above it
+        template<class T, class Reduce>
+        void Build(std::vector<T>& texels, Reduce reduce, ThreadPool* pool = nullptr) const;
+
+        // base level lookup, fetch maps a texel index to its value.
+        // Texel i covers [i, i + 1) / size, with its centre at (i + 0.5) / size
+        template<class R, class Fetch>
+        R SampleNearest(float x, float y, Fetch fetch) const;
+
+        // lod is log2 of the sample footprint in uv units
+        template<class R, class Fetch>
+        R SampleTrilinear(const float x, const float y, float lod, Fetch fetch) const;
+
+        size_t Index(const int level, const int x, const int y) const;
+
+        static constexpr int tileShift = 3,
+            tileSize = 1 << tileShift,
+            tileMask = tileSize - 1;
+
+    private:
+        template<class R, class Fetch>
+        R sampleBilinear(const int level, float x, float y, Fetch fetch) const;
+        // Index is rowIndex + columnIndex, so a bilinear footprint
+        // needs two of each rather than four full indices
+        static size_t rowIndex(const MipLevel& l, const int y);
+        static size_t columnIndex(const int x);
+        template<class Job>
+        static void forRows(const int rows, Job job, ThreadPool* pool);
+
+        std::vector<MipLevel> levels;
+        float sizeLog2;
+
+        // Z-order offsets of the x and y bits inside a tile
+        static constexpr uint8_t mortonX[tileSize] = {0, 1, 4, 5, 16, 17, 20, 21},
+            mortonY[tileSize] = {0, 2, 8, 10, 32, 34, 40, 42};
+};
+
+inline size_t MipChain::rowIndex(const MipLevel& l, const int y)
+{
+    return l.offset + (y >> tileShift) * l.tileRowTexels + mortonY[y & tileMask];
+}
+
+inline size_t MipChain::columnIndex(const int x)
+{
+    return (static_cast<size_t>(x >> tileShift) << (tileShift * 2)) + mortonX[x & tileMask];
+}
+
+inline size_t MipChain::Index(const int level, const int x, const int y) const
+{
+    return rowIndex(levels[level], y) + columnIndex(x);
+}
+
+template<class Job>
+void MipChain::forRows(const int rows, Job job, ThreadPool* pool)
+{
+    if (pool != nullptr)
+    {
+        pool->Run(rows, job);
+        return;
+    }
+
+    for (int y = 0; y < rows; ++y)
+    {
+        job(y);
+    }
+}
+
+template<class T, class Convert>
+void MipChain::Fill(std::vector<T>& texels, Convert convert, ThreadPool* pool) const
+{
+    const MipLevel& l = levels[0];
+
+    forRows(l.height, [&](int y)
+    {
+        for (int x = 0; x < l.width; ++x)
+        {
+            texels[Index(0, x, y)] = convert(static_cast<size_t>(y) * l.width + x);
+        }
+    }, pool);
+}
+
+template<class T, class Reduce>
+void MipChain::Build(std::vector<T>& texels, Reduce reduce, ThreadPool* pool) const
+{
+    for (int l = 1; l < static_cast<int>(levels.size()); ++l)
+    {
+        const MipLevel& src = levels[l - 1],
+            & dst = levels[l];
+
+        forRows(dst.height, [&](int y)
+        {
+            const int y0 = std::min(y * 2, src.height - 1),
+                y1 = std::min(y * 2 + 1, src.height - 1);
+
+            for (int x = 0; x < dst.width; ++x)
+            {
+                const int x0 = std::min(x * 2, src.width - 1),
+                    x1 = std::min(x * 2 + 1, src.width - 1);
+
+                texels[Index(l, x, y)] = reduce(texels[Index(l - 1, x0, y0)],
+                                                texels[Index(l - 1, x1, y0)],
+                                                texels[Index(l - 1, x0, y1)],
+                                                texels[Index(l - 1, x1, y1)]);
+            }
+        }, pool);
+    }
+}
+
+template<class R, class Fetch>
+R MipChain::SampleNearest(float x, float y, Fetch fetch) const
+{
+    const MipLevel& l = levels[0];
+
+    x = std::clamp(x, 0.0f, 1.0f) * l.width;
+    y = std::clamp(y, 0.0f, 1.0f) * l.height;
+
+    // the texel whose centre is nearest, as sampleBilinear places them
+    const int newX = std::min(static_cast<int>(x), l.width - 1),
+        newY = std::min(static_cast<int>(y), l.height - 1);
+
+    return fetch(Index(0, newX, newY));
+}
+
+template<class R, class Fetch>
+R MipChain::SampleTrilinear(const float x, const float y, float lod, Fetch fetch) const
+{
+    const int maxLevel = levels.size() - 1;
+
+    lod += sizeLog2;
+
+    // magnification, also catches a degenerate footprint
+    if (!(lod > 0.0f))
+    {
+        return sampleBilinear<R>(0, x, y, fetch);
+    }
+
+    if (lod >= maxLevel)
+    {
+        return sampleBilinear<R>(maxLevel, x, y, fetch);
+    }
+
+    const int level = lod;
+    const float t = lod - level;
+
+    const R a = sampleBilinear<R>(level, x, y, fetch),
+        b = sampleBilinear<R>(level + 1, x, y, fetch);
+
+    return a + (b - a) * t;
+}
+
+template<class R, class Fetch>
+R MipChain::sampleBilinear(const int level, float x, float y, Fetch fetch) const
+{
+    const MipLevel& l = levels[level];
+
+    x = std::clamp(x, 0.0f, 1.0f) * l.width - 0.5f;
+    y = std::clamp(y, 0.0f, 1.0f) * l.height - 0.5f;
+
+    // x, y >= -0.5, so truncation after the shift is floor
+    const int ix = static_cast<int>(x + 1.0f) - 1,
+        iy = static_cast<int>(y + 1.0f) - 1;
+
+    const float tx = x - ix,
+        ty = y - iy;
+
+    // clamp to edge
+    const int x0 = std::max(ix, 0),
+        y0 = std::max(iy, 0),
+        x1 = std::min(ix + 1, l.width - 1),
+        y1 = std::min(iy + 1, l.height - 1);
+
+    const size_t row0 = rowIndex(l, y0),
+        row1 = rowIndex(l, y1),
+        col0 = columnIndex(x0),
+        col1 = columnIndex(x1);
+
+    const R a = fetch(row0 + col0),
+        b = fetch(row0 + col1),
+        c = fetch(row1 + col0),
+        d = fetch(row1 + col1);
+
+    const R top = a + (b - a) * tx,
+        bottom = c + (d - c) * tx;
+
+    return top + (bottom - top) * ty;
+}
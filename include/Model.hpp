@@ -1,29 +1,123 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstdint>
 #include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
 #include "Face.hpp"
+#include "Cluster.hpp"
 #include "Vertex.hpp"
+#include "ThreadPool.hpp"
 
 class Model
 {
     public:
-        Model(const std::string& filename);
+        // optimize reorders clusters and faces for cache reuse and overdraw,
+        // compress stores the model's cache lossily encoded,
+        // parsing and the per-vertex passes run on pool
+        Model(const std::string& filename, const bool optimize, const bool compress,
+              ThreadPool& pool);
 
+        // welded vertex attributes, one entry per unique position, uv and normal.
+        // Empty after quantizeAttributes, which moves them to the packed arrays
         std::vector<glm::vec3> vertices, normals, tangents;
         std::vector<glm::vec2> uvs;
+        // positions normalized to 16 bits within the mesh bounds, with
+        // position = positionOffset + packedVertices * positionScale,
+        // octahedral normals and tangents, and half precision uvs
+        std::vector<glm::u16vec3> packedVertices;
+        std::vector<glm::u16vec2> packedNormals, packedTangents;
+        std::vector<uint32_t> packedUVs;
+        glm::vec3 positionOffset, positionScale;
         std::vector<Face> faces;
+        // faces are stored grouped by cluster
+        std::vector<Cluster> clusters;
 
         void getVertices(const Face f, Vertex& a, Vertex& b, Vertex& c);
+        int getVertexCount() const;
+        bool isQuantized() const;
+
+        // replaces the float attributes, 44 bytes per vertex, with the
+        // 18 byte packed ones, clusters keep their float bounds
+        void quantizeAttributes(ThreadPool& pool);
 
     private:
-        glm::ivec3 loadFaceVertex(std::ifstream& file);
-        void loadVertex(std::ifstream& file);
-        void loadFace(std::ifstream& file);
-        void loadTextureCoords(std::ifstream& file);
-        void loadNormal(std::ifstream& file);
-        void adjustIndices();
-        void centerModel();
-        void calcTangents();
+        // element counts of OBJ text, for exact reservations
+        struct ObjCounts
+        {
+            int vertices, uvs, normals, faces, corners;
+        };
+
+        // newline-aligned part of the OBJ text, parsed independently of the others
+        struct ObjChunk
+        {
+            const char *begin, *end;
+            ObjCounts counts;
+            // elements read so far in the whole file, starting at the total of the
+            // chunks before, face indices resolve against these
+            int vertices, uvs, normals;
+            // position, uv and normal indices of every face corner, resolved to 0-based
+            std::vector<glm::ivec3> corners;
+            bool parsed;
+        };
+
+        static ObjCounts countElements(const char* p, const char* end);
+        // parses the chunk's lines into the presized attribute arrays,
+        // false on malformed input
+        bool parseChunk(ObjChunk& chunk);
+        // the load functions read from p up to end, which is the end of the line
+        static bool loadFaceVertex(const char*& p, const char* end, const ObjChunk& chunk,
+                                   glm::ivec3& v);
+        bool loadVertex(const char*& p, const char* end, ObjChunk& chunk);
+        static bool loadFace(const char*& p, const char* end, ObjChunk& chunk);
+        bool loadTextureCoords(const char*& p, const char* end, ObjChunk& chunk);
+        bool loadNormal(const char*& p, const char* end, ObjChunk& chunk);
+        // first token of the line, p is moved past it
+        static std::string_view lineKeyword(const char*& p, const char* lineEnd);
+        static int resolveIndex(const int i, const int count);
+        static bool parseFloat(const char*& p, const char* end, float& v);
+        static bool parseInt(const char*& p, const char* end, int& v);
+        static void skipSpaces(const char*& p, const char* end);
+        static bool isSpace(const char c);
+        static const char* lineEndOf(const char* p, const char* end);
+        // replaces the file's attribute lists with one entry per unique corner,
+        // false if a corner's position index is out of range
+        bool weldVertices(const std::vector<glm::ivec3>& corners);
+        void centerModel(ThreadPool& pool);
+        void calcTangents(ThreadPool& pool);
+        // partitions faces into clusters and renumbers vertices in cluster order
+        void buildClusters(const bool optimize);
+        // greedy region growing over faces that share a vertex, returns the new face order
+        std::vector<int> partitionFaces(const std::vector<glm::vec3>& faceNormals,
+                                        const std::vector<glm::vec3>& centroids,
+                                        const glm::vec3 lo, const glm::vec3 hi);
+        void calcClusterBounds(Cluster& cl);
+        // faces around each vertex in ascending order,
+        // adjacent[firstAdjacent[v] .. firstAdjacent[v + 1])
+        void vertexFaces(std::vector<int>& firstAdjacent, std::vector<int>& adjacent) const;
+        // unit normal, zero for degenerate faces
+        glm::vec3 faceNormal(const Face f) const;
+        // puts clusters facing out from the mesh centre first, for less overdraw
+        void sortClusters();
+        // reorders the cluster's faces for post-transform cache reuse,
+        // localIndex is all -1 on entry and on return
+        void reorderFaces(const Cluster& cl, std::vector<int>& localIndex);
+        // average cache misses per face
+        float calcACMR(const int cacheSize) const;
+        // p in [0, 1]^3, 10 bits per axis
+        static uint32_t mortonCode(const glm::vec3 p);
+
+        constexpr static int minClusterFaces = 64, maxClusterFaces = 128;
+        // clusters past minClusterFaces end at a face whose normal is
+        // further than acos(coneSplit) from the cluster's average
+        constexpr static float coneSplit = 0.9f;
+        // FIFO entries assumed by reorderFaces and calcACMR
+        constexpr static int cacheSize = 16;
+        // OBJ text per parsing job, extended to the next line end
+        constexpr static size_t chunkBytes = 1 << 18;
+        // vertices or faces per job in the parallel passes, fixed so the
+        // results do not depend on the thread count
+        constexpr static int batchSize = 1 << 14;
 };
@@ -4,14 +4,21 @@
 #include <string>
 #include "glm/glm.hpp"
 #include "TextureType.hpp"
+#include "MipChain.hpp"
 
 class MonoTexture
 {
     public:
         MonoTexture(const std::string& filename, TextureType type);
         float getVal(float x, float y);
+        // trilinear, lod is log2 of the sample footprint in uv units
+        float getVal(float x, float y, float lod);
+        unsigned getWidth() const;
+        unsigned getHeight() const;
 
     private:
-        std::vector<unsigned char> data;
+        // all mip levels
+        std::vector<unsigned char> texels;
+        MipChain mips;
         unsigned width, height;
 };
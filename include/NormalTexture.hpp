@@ -3,14 +3,30 @@
 #include <vector>
 #include <string>
 #include "glm/glm.hpp"
+#include "glm/gtc/type_precision.hpp"
+#include "MipChain.hpp"
+#include "ThreadPool.hpp"
 
 class NormalTexture
 {
     public:
-        NormalTexture(const std::string& filename);
+        // the texels are converted on the pool
+        NormalTexture(const std::string& filename, ThreadPool& pool);
         glm::vec3 getNormal(float x, float y);
+        // trilinear, lod is log2 of the sample footprint in uv units
+        glm::vec3 getNormal(float x, float y, float lod);
+        unsigned getWidth() const;
+        unsigned getHeight() const;
+
+        // true if the file failed to load and a 1x1 fallback is used
+        bool isDefault() const;
 
     private:
-        std::vector<glm::vec3> normals;
+        glm::vec3 fetch(const size_t i) const;
+
+        // all mip levels, octahedral encoding
+        std::vector<glm::u16vec2> normals;
+        MipChain mips;
         unsigned width, height;
+        bool defaultMap;
 };
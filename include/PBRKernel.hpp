@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// up to size PBR fragments in structure of arrays form
+struct PBRPacket
+{
+    static constexpr int size = 8;
+
+    alignas(32) float nx[size], ny[size], nz[size],
+        px[size], py[size], pz[size],
+        albedoR[size], albedoG[size], albedoB[size],
+        metallic[size], roughness[size], ao[size],
+        emissionR[size], emissionG[size], emissionB[size];
+
+    // shaded linear HDR colour
+    alignas(32) float r[size], g[size], b[size];
+
+    // destination pixel of each lane
+    int x[size], y[size];
+    float z[size];
+    int count;
+
+    void Add(const int x, const int y, const float z,
+             const glm::vec3 n, const glm::vec3 pos, const glm::vec3 albedo,
+             const float metallic, const float roughness, const float ao,
+             const glm::vec3 emission);
+};
+
+class PBRKernel
+{
+    public:
+        // shades the first count lanes with the best kernel the CPU supports
+        static void Shade(PBRPacket& p, const glm::vec3 lightVecView);
+        static void ShadeScalar(PBRPacket& p, const glm::vec3 lightVecView);
+        static void ShadeAVX2(PBRPacket& p, const glm::vec3 lightVecView);
+        static bool HasAVX2();
+
+        // albedo is linear
+        static glm::vec3 ShadeFragment(const glm::vec3 n, const glm::vec3 pos, const glm::vec3 albedo,
+                                       const float metallic, const float roughness,
+                                       const float ao, const glm::vec3 emission,
+                                       const glm::vec3 lightVecView);
+};
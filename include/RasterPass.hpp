@@ -0,0 +1,13 @@
+#pragma once
+
+enum RasterPass
+{
+    // depth test and shading in one go
+    ForwardPass,
+    // depth only, no shading
+    DepthPrepass,
+    // shade the fragments that won the depth prepass
+    ShadingPass,
+    // depth test, store the triangle id only
+    VisibilityPass
+};
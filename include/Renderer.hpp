@@ -6,7 +6,19 @@
 #include "Texture.hpp"
 #include "NormalTexture.hpp"
 #include "MonoTexture.hpp"
+#include "MaterialTexture.hpp"
+#include "ColorLUT.hpp"
+#include "Triangle.hpp"
+#include "Tile.hpp"
+#include "RasterPass.hpp"
+#include "VisibilitySample.hpp"
+#include "VertexCache.hpp"
+#include "FragmentKernel.hpp"
+#include "PBRKernel.hpp"
+#include "ThreadPool.hpp"
 #include <string>
+#include <vector>
+#include <glm/gtc/type_precision.hpp>
 
 class Renderer
 {
@@ -23,48 +35,186 @@ class Renderer
         void LoadMetallic(const std::string& filename);
         void LoadRoughness(const std::string& filename);
         void LoadAO(const std::string& filename);
+        void LoadLUT(const std::string& filename);
 
         float FOV, ambientFactor, lambertFactor, spec1, spec2;
-        bool backfaceCulling, perspectiveCorrection;
+        bool backfaceCulling, occlusionCulling, perspectiveCorrection, depthPrepass,
+            deferredShading, mipmapping, colorGrading;
+        // per-frame counters on stdout
+        bool printStats;
+        // apply to the next LoadModel, a compressed cache trades
+        // 16 bit attribute precision for a smaller file, quantized
+        // vertices do the same for memory
+        bool optimizeModel, compressModelCache, quantizeVertices;
         glm::vec3 camPos, modelScale,
             modelPos, modelRot;
 
         glm::vec2 lightDir;
         Shading shading;
+        int threadCount;
 
     private:
         int index(int i, int j) const;
-        void drawTriangle(Vertex va, Vertex vb, Vertex vc);
-        void drawTopTriangle(Vertex va, Vertex vb, Vertex vc);
-        void drawBottomTriangle(Vertex va, Vertex vb, Vertex vc);
-        void drawLeftTriangle(Vertex va, Vertex vb, Vertex vc);
-        void drawRightTriangle(Vertex va, Vertex vb, Vertex vc);
-        void drawFragment(const glm::vec3 br, const int x, const int y,
-                           const Vertex va, const Vertex vb,
-                          const Vertex vc);
+        // blockDepth entry of the block at pixel (bx, by)
+        int blockIndex(const int bx, const int by) const;
+        // fills visibleClusters with the clusters that pass the frustum and cone
+        // tests, those drawn last frame go to firstPassClusters
+        void cullClusters();
+        bool clusterInView(const Cluster& cl, const glm::vec4* planes,
+                           const glm::vec3 viewDir) const;
+        // tests visibleClusters against the depth of the first pass, the ones
+        // that were hidden last frame and are not now go to secondPassClusters
+        void cullOccludedClusters();
+        bool clusterOccluded(const Cluster& cl, const glm::mat4& mv,
+                             const float radiusScale) const;
+        // farthest depth over the pixel rectangle [x0, x1] x [y0, y1]
+        float maxDepth(const int x0, const int y0, const int x1, const int y1) const;
+        // transforms the clusters' vertex ranges
+        void transformVertices(const std::vector<int>& ids);
+        void transformVertices(const size_t begin, const size_t end);
+        // src is float or packed model attributes, which are decoded here
+        template<class T>
+        void transformPositions(const glm::mat4 mv, const T * __restrict src,
+                                const size_t begin, const size_t end);
+        template<class T>
+        static void transformDirections(const glm::mat3 m, const T * __restrict src,
+                                        float * __restrict dstX, float * __restrict dstY,
+                                        float * __restrict dstZ,
+                                        const size_t begin, const size_t end);
+        Vertex fetchVertex(const Face& f, const int i) const;
+        glm::vec4 clipPosition(const int v) const;
+        void setupTriangle(const Face& f);
+        int outCode(const glm::vec4 p) const;
+        float planeDistance(const glm::vec4 p, const int plane) const;
+        void clipTriangle(const glm::vec4 a, const glm::vec4 b, const glm::vec4 c,
+                          const Vertex va, const Vertex vb, const Vertex vc,
+                          const int planes);
+        void addTriangle(Vertex va, Vertex vb, Vertex vc);
+        static void setupPlanes(Triangle& tr, const double invArea,
+                                const Vertex& va, const Vertex& vb, const Vertex& vc);
+        static glm::i64vec2 snapToGrid(const glm::vec3 p);
+        static EdgeFunction setupEdge(const glm::i64vec2 p, const glm::i64vec2 q);
+        template<class V, RasterPass Pass> int drawTriangle(const int id, Tile& tile);
+        template<RasterPass Pass>
+        static bool occluded(const float zMin, const float maxDepth);
+        static float blockMinDepth(const Triangle& tr, const int bx, const int by);
+        void updateBlockDepth(const int bx, const int by);
+        void updateTileDepth(Tile& tile);
+        static uint64_t coverBlock(const Triangle& tr, const int bx, const int by);
+        static uint64_t blockRectMask(const int bx, const int by,
+                                      const int x0, const int y0,
+                                      const int x1, const int y1);
+        template<class V, RasterPass Pass>
+        int drawBlock(const int id, const int bx, const int by, uint64_t mask,
+                      PBRPacket& packet);
+        // attr holds the attributes forEachAttribute<V> lists, at (x, y)
+        template<class V>
+        void drawFragment(const Triangle& tr, const float* attr, const int x, const int y,
+                          const float z, PBRPacket& packet);
+        // calls op(first, count) for each run of attributes V's kernel reads
+        template<class V, class Op>
+        static void forEachAttribute(Op op);
+        template<class V>
+        static void evalAttributes(const Triangle& tr, const int x, const int y, float* attr);
+        // adds one pixel's dx or dy
+        template<class V>
+        static void stepAttributes(const float* step, float* attr);
+        template<class V>
+        static void copyAttributes(const float* src, float* dst);
+        void flushPacket(PBRPacket& packet);
+        template<class V>
+        static float calcLod(const Triangle& tr, const float* attr, const glm::vec2 t);
+        template<class V>
+        static glm::vec3 sampleCol(Texture* tex, const glm::vec2 t, const float lod);
+        template<class V>
+        static float sampleVal(MonoTexture* tex, const glm::vec2 t, const float lod);
+        template<class V>
+        static glm::vec3 sampleNormal(NormalTexture* tex, const glm::vec2 t, const float lod);
+        template<class V>
+        static MaterialSample sampleMaterial(MaterialTexture* tex, const glm::vec2 t,
+                                             const float lod);
+        // creates the pool or resizes it to threadCount
+        void updatePool();
+        // the packed material is rebuilt lazily after any PBR input changes
+        void invalidateMaterial();
         void renderModel();
-        void setPixel(const int x, const int y, const float z, glm::vec3 c);
-        template<typename T> static T Interpolate(const glm::vec3 br, const T a, const T b, const T c);
-        static glm::vec3 InterpolateNormals(const glm::vec3 br, const glm::vec3 a, const glm::vec3 b, const glm::vec3 c);
+        void genTiles();
+        // bins triangles [first, triangles.size())
+        void binTriangles(const size_t first);
+        // renders one tile with the fragment kernel picked for the frame
+        typedef void (Renderer::*TileRenderer)(Tile& tile);
+        // draws the clusters on top of the depth already in the frame
+        void renderClusters(const std::vector<int>& ids, const TileRenderer renderTile);
+        TileRenderer selectTileRenderer() const;
+        template<Shading S>
+        static TileRenderer selectTileRenderer(const bool perspectiveCorrection,
+                                               const bool normalMap,
+                                               const bool emissionMap,
+                                               const bool mipmapping);
+        template<class V> void renderTile(Tile& tile);
+        template<class V> int shadeTile(const Tile& tile);
+        void setPixel(const int x, const int y, const float z, const glm::vec3 c);
+        // also counts the tile's covered pixels
+        void resolveTile(Tile& tile);
+        void allocateBuffers();
+        void freeBuffers();
         static bool canCull(const glm::vec2 a, const glm::vec2 b, const glm::vec2 c);
         void genProjectionMatrix();
         void genViewportMatrix();
         void genViewMatrix();
         void genModelMatrix();
         void genLightVec();
-        glm::vec3 calcNormal(const glm::vec3 n, glm::vec3 tangent, const glm::vec2 t);
+        static glm::vec3 calcNormal(const glm::vec3 n, glm::vec3 tangent, glm::vec3 mapNormal);
         glm::vec3 calcBlinnPhongShading(const glm::vec3 p, const glm::vec3 n);
-        glm::vec3 getPBR(glm::vec3 n, glm::vec3 pos, glm::vec3 albedo,
-                         float metallic, float roughness, float ao, glm::vec3 emission);
 
         glm::mat4 modelMat, viewMat, projMat, viewportMat;
         glm::vec3 lightVec, lightVecView;
+        // RGBA8, what Render returns
         uint8_t *buffer;
+        // linear RGBA colour, resolved into buffer once per frame
+        float *hdrBuffer;
         float *zBuffer;
+        // farthest depth per block, Tile::maxDepth is the level above
+        float *blockDepth;
+        int blocksX, blocksY;
+        // triangle id per pixel for deferred shading, attributes come
+        // from its plane equations
+        VisibilitySample *visBuffer;
         int width, height, culledFaces;
         constexpr static float zNear = 0.1f, zFar = 100.0f;
+        constexpr static int tileSize = 64, blockSize = 8;
+        // one row of a block's coverage mask
+        constexpr static uint64_t rowBits = (1ull << blockSize) - 1;
+        constexpr static size_t bufferAlignment = 64;
+        // clusters per vertex transform job
+        constexpr static int clusterBatchSize = 64;
+        // normal cone slack for float rounding in the face normals
+        constexpr static float coneSlack = 1e-3f;
+        // occlusion tests covering more blocks than this read the tile level
+        constexpr static int maxOcclusionBlocks = 16;
+        constexpr static int64_t subpixelScale = 256;
+        // slack for float rounding in the depth planes
+        constexpr static float depthEpsilon = 1e-6f;
+        // near, far and the four guard band planes
+        constexpr static int clipPlaneCount = 6;
+        // limit on clipped screen coordinates, in pixels
+        constexpr static float guardBand = 1 << 16;
+        float guardX, guardY;
+        VertexCache vertexCache;
+        std::vector<int> visibleClusters, firstPassClusters, secondPassClusters;
+        // 1 for clusters that were drawn and not occluded last frame
+        std::vector<uint8_t> visibleLastFrame;
+        // 1 for clusters whose vertex ranges are transformed this frame
+        std::vector<uint8_t> clusterTransformed;
+        int occludedClusters;
+        std::vector<Triangle> triangles;
+        std::vector<Tile> tiles;
+        int tilesX, tilesY;
+        ThreadPool *pool;
         Model *model;
         Texture *texDiffuse, *texSpecular, *texEmission;
         NormalTexture *texNormal;
         MonoTexture *texMetallic, *texRoughness, *texAO;
+        MaterialTexture *material;
+        ColorLUT *lut;
 };
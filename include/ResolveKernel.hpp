@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+// converts linear HDR colour to the displayed RGBA8 frame
+class ResolveKernel
+{
+    public:
+        // src is RGBA float, dst RGBA8 with opaque alpha. With tonemap set
+        // the colour is Reinhard tonemapped and gamma encoded, otherwise
+        // it is taken as display encoded and only clamped
+        static void Resolve(const float* src, uint8_t* dst, const int count, const bool tonemap);
+        static void ResolveScalar(const float* src, uint8_t* dst, const int count,
+                                  const bool tonemap);
+        static void ResolveAVX2(const float* src, uint8_t* dst, const int count,
+                                const bool tonemap);
+};
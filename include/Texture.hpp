@@ -3,15 +3,29 @@
 #include <vector>
 #include <string>
 #include "glm/glm.hpp"
+#include "glm/gtc/type_precision.hpp"
 #include "TextureType.hpp"
+#include "MipChain.hpp"
 
 class Texture
 {
     public:
         Texture(const std::string& filename, TextureType type);
         glm::vec3 getCol(float x, float y);
+        // trilinear, lod is log2 of the sample footprint in uv units
+        glm::vec3 getCol(float x, float y, float lod);
+        unsigned getWidth() const;
+        unsigned getHeight() const;
+
+        // true if the file failed to load and a 1x1 fallback is used
+        bool isDefault() const;
 
     private:
-        std::vector<unsigned char> data;
+        glm::vec3 fetch(const size_t i) const;
+
+        // all mip levels
+        std::vector<glm::u8vec3> texels;
+        MipChain mips;
         unsigned width, height;
+        bool defaultMap;
 };
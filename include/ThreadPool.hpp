@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+class ThreadPool
+{
+    public:
+        ThreadPool(int threadCount);
+        ~ThreadPool();
+
+        int GetThreadCount() const;
+        // runs job(0) .. job(jobCount - 1) on the pool, the calling thread included
+        void Run(int jobCount, const std::function<void(int)>& job);
+
+    private:
+        void workerLoop();
+        void runJobs();
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable cvStart, cvDone;
+        const std::function<void(int)> *job;
+        std::atomic<int> nextJob;
+        int jobCount, activeWorkers;
+        unsigned generation;
+        bool stopping;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <vector>
+
+struct Tile
+{
+    // pixel rectangle [x0, x1) x [y0, y1)
+    int x0, y0, x1, y1;
+    // indices into the frame's triangle list, in submission order
+    std::vector<int> triangles;
+    // fragments shaded and pixels covered in the last frame
+    int fragments, coveredPixels;
+    // conservative farthest depth in the tile, the coarsest depth hierarchy level
+    float maxDepth;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+// E(x, y) = stepX * x + stepY * y + offset, evaluated at the centre of
+// pixel (x, y) in squared subpixel units; pixel is inside if E >= threshold
+struct EdgeFunction
+{
+    int64_t stepX, stepY, offset, threshold;
+};
+
+// interpolated fragment inputs, indices into the plane arrays of Triangle
+enum Attribute
+{
+    AttrDepth,
+    AttrNormal,
+    AttrTangent = AttrNormal + 3,
+    AttrPosView = AttrTangent + 3,
+    // 1 / posView.z and uv / posView.z for perspective correct uvs
+    AttrInvDepth = AttrPosView + 3,
+    AttrUVOverDepth,
+    AttrUV = AttrUVOverDepth + 2,
+    AttributeCount = AttrUV + 2
+};
+
+// screen space triangle ready for rasterization
+struct Triangle
+{
+    EdgeFunction edges[3];
+    // covered pixel rectangle [xMin, xMax) x [yMin, yMax), clamped to the screen
+    int xMin, yMin, xMax, yMax;
+    // lower bound of the triangle's depth, for hierarchical rejection
+    float zMin;
+    // attribute i at pixel (x, y) is
+    // base[i] + dx[i] * (x - xMin) + dy[i] * (y - yMin)
+    float base[AttributeCount], dx[AttributeCount], dy[AttributeCount];
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
 
 class Utils
 {
@@ -10,6 +11,12 @@ public:
     static float GeometrySchlickGGX(float NdotV, float roughness);
     static float GeometrySmith(glm::vec3 n, glm::vec3 v, glm::vec3 l, float roughness);
     static glm::vec3 FresnelSchlick(float cosTheta, glm::vec3 F0);
+    // unit vector to and from the [-1, 1] square of an octahedral map
+    static glm::vec2 OctEncode(glm::vec3 n);
+    static glm::vec3 OctDecode(const glm::vec2 e);
+    // octahedral encoding quantized to 2x16 bits, +z for vectors with no direction
+    static glm::u16vec2 PackNormal(const glm::vec3 n);
+    static glm::vec3 UnpackNormal(const glm::u16vec2 e);
 
     static constexpr float pi = std::acos(-1.0f);
 };
@@ -7,5 +7,7 @@ struct Vertex
     glm::vec3 v, n, posView, tangent;
     glm::vec2 t;
 
+    // linear blend of all attributes; ratio is measured in view or clip
+    // space, where the attributes are affine along the edge
     static Vertex Combine(const Vertex a, const Vertex b, const float ratio);
 };
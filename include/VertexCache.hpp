@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+// post-transform model attributes, computed once per frame
+// and stored as a structure of arrays
+struct VertexCache
+{
+    // indexed like Model::vertices
+    std::vector<float> viewX, viewY, viewZ,
+        clipX, clipY, clipZ, clipW,
+        screenX, screenY, screenZ,
+        normalX, normalY, normalZ,
+        tangentX, tangentY, tangentZ;
+
+    void Resize(const size_t vertexCount);
+};
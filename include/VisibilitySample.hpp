@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+// one pixel of the visibility buffer
+struct VisibilitySample
+{
+    // index into the frame's triangle list; the attributes are
+    // recovered from its plane equations at the pixel position
+    uint32_t triangle;
+
+    static constexpr uint32_t noTriangle = UINT32_MAX;
+};
@@ -104,6 +104,7 @@ void GUI_Main(GLFWwindow *window)
         renderer.LoadRoughness(modelName);
         renderer.LoadEmission(modelName);
         renderer.LoadAO(modelName);
+        renderer.LoadLUT(modelName);
     }
 
     ImGui::SameLine();
@@ -129,8 +130,26 @@ void GUI_Main(GLFWwindow *window)
 
     ImGui::Checkbox("Backface culling", &renderer.backfaceCulling);
 
+    ImGui::Checkbox("Occlusion culling", &renderer.occlusionCulling);
+
     ImGui::Checkbox("Perspective correction", &renderer.perspectiveCorrection);
 
+    ImGui::Checkbox("Depth prepass", &renderer.depthPrepass);
+
+    ImGui::Checkbox("Deferred shading", &renderer.deferredShading);
+
+    ImGui::Checkbox("Mipmapping", &renderer.mipmapping);
+
+    ImGui::Checkbox("Colour grading", &renderer.colorGrading);
+
+    ImGui::Checkbox("Print frame stats", &renderer.printStats);
+
+    ImGui::Checkbox("Optimize model on load", &renderer.optimizeModel);
+    ImGui::Checkbox("Compress model cache", &renderer.compressModelCache);
+    ImGui::Checkbox("Quantize vertices", &renderer.quantizeVertices);
+
+    ImGui::SliderInt("Threads", &renderer.threadCount, 1, 64);
+
     ImGui::Text("Shading:");
     ImGui::SameLine();
     ImGui::RadioButton("None", (int*)&renderer.shading, (int)None);
@@ -0,0 +1,105 @@
+#include "ColorLUT.hpp"
+
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+ColorLUT::ColorLUT(const std::string& filename)
+{
+    size = 0;
+    domainMin = glm::vec3(0.0f);
+    domainMax = glm::vec3(1.0f);
+
+    std::ifstream file(filename);
+
+    if (!file.is_open())
+    {
+        printf("No colour grading table loaded\n\n");
+        return;
+    }
+
+    std::string s;
+
+    while (file >> s)
+    {
+        if (s == "LUT_3D_SIZE")
+        {
+            file >> size;
+        }
+        else if (s == "DOMAIN_MIN")
+        {
+            file >> domainMin.x >> domainMin.y >> domainMin.z;
+        }
+        else if (s == "DOMAIN_MAX")
+        {
+            file >> domainMax.x >> domainMax.y >> domainMax.z;
+        }
+        else if (s[0] == '-' || s[0] == '.' || (s[0] >= '0' && s[0] <= '9'))
+        {
+            glm::vec3 c;
+            char *end;
+            c.x = std::strtof(s.c_str(), &end);
+
+            // tokens like "-x" or "." are not numbers, the emptied table fails below
+            if (end == s.c_str() || *end != '\0' || !(file >> c.y >> c.z))
+            {
+                table.clear();
+                break;
+            }
+
+            table.push_back(c);
+            continue;
+        }
+
+        if (!file && !file.eof())
+        {
+            break;
+        }
+
+        // keywords this loader does not use, like TITLE
+        std::getline(file, s);
+    }
+
+    file.close();
+
+    if (size < 2 || table.size() != static_cast<size_t>(size) * size * size)
+    {
+        printf("Colour grading table parsing failed\n\n");
+
+        size = 0;
+        table.clear();
+        return;
+    }
+
+    printf("Loaded colour grading table, size: %d\n\n", size);
+}
+
+glm::vec3 ColorLUT::apply(const glm::vec3 c) const
+{
+    const glm::vec3 p = glm::clamp((c - domainMin) / (domainMax - domainMin), 0.0f, 1.0f) *
+        static_cast<float>(size - 1);
+
+    const int r0 = std::min(static_cast<int>(p.x), size - 2),
+        g0 = std::min(static_cast<int>(p.y), size - 2),
+        b0 = std::min(static_cast<int>(p.z), size - 2);
+
+    const glm::vec3 t = p - glm::vec3(r0, g0, b0);
+
+    const glm::vec3 c00 = glm::mix(entry(r0, g0, b0), entry(r0 + 1, g0, b0), t.x),
+        c10 = glm::mix(entry(r0, g0 + 1, b0), entry(r0 + 1, g0 + 1, b0), t.x),
+        c01 = glm::mix(entry(r0, g0, b0 + 1), entry(r0 + 1, g0, b0 + 1), t.x),
+        c11 = glm::mix(entry(r0, g0 + 1, b0 + 1), entry(r0 + 1, g0 + 1, b0 + 1), t.x);
+
+    return glm::mix(glm::mix(c00, c10, t.y), glm::mix(c01, c11, t.y), t.z);
+}
+
+bool ColorLUT::isLoaded() const
+{
+    return size != 0;
+}
+
+glm::vec3 ColorLUT::entry(const int r, const int g, const int b) const
+{
+    return table[(b * size + g) * size + r];
+}
@@ -1,8 +1,6 @@
 #include "Face.hpp"
 
-Face::Face(const glm::ivec3 v, const glm::ivec3 t, const glm::ivec3 n)
+Face::Face(const glm::ivec3 v)
 {
     this->vertices = v;
-    this->uvs = t;
-    this->normals = n;
 }
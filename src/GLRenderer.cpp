@@ -24,7 +24,8 @@ void GLRenderer::Init(int width, int height)
 
     texId = loader.createTexture(width, height);
 
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // RGBA8 rows are always 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 }
 
 void GLRenderer::Prepare()
@@ -0,0 +1,27 @@
+#include "GammaTable.hpp"
+
+#include <cmath>
+
+const GammaTable::Tables GammaTable::tables;
+
+GammaTable::Tables::Tables()
+{
+    for (int i = 0; i < 256; ++i)
+    {
+        decode[i] = std::round(std::pow(i / 255.0f, 2.2f) * 65535.0f);
+    }
+
+    for (int i = 0; i < encodeSize; ++i)
+    {
+        // middle of the range of floats that share the index
+        const uint32_t bits = (static_cast<uint32_t>(firstIndex + i) << (23 - mantissaBits)) |
+            (1u << (22 - mantissaBits));
+
+        float c;
+        std::memcpy(&c, &bits, sizeof(c));
+
+        encode[i] = std::round(std::pow(c, 1.0f / 2.2f) * 255.0f);
+    }
+
+    std::memset(encode + encodeSize, 0, 3);
+}
@@ -0,0 +1,163 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& filename)
+{
+    data = nullptr;
+    size = 0;
+    modifiedTime = 0;
+    open = false;
+    mapping = nullptr;
+
+    file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                       OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        file = nullptr;
+        return;
+    }
+
+    LARGE_INTEGER fileSize;
+
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        return;
+    }
+
+    FILETIME writeTime;
+
+    if (!GetFileTime(file, nullptr, nullptr, &writeTime))
+    {
+        return;
+    }
+
+    size = fileSize.QuadPart;
+    modifiedTime = ((uint64_t)writeTime.dwHighDateTime << 32) | writeTime.dwLowDateTime;
+    open = true;
+
+    if (size == 0)
+    {
+        return;
+    }
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (mapping != nullptr)
+    {
+        data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+
+    open = data != nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+    }
+
+    if (mapping != nullptr)
+    {
+        CloseHandle(mapping);
+    }
+
+    if (file != nullptr)
+    {
+        CloseHandle(file);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& filename)
+{
+    data = nullptr;
+    size = 0;
+    modifiedTime = 0;
+    open = false;
+
+    fd = ::open(filename.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        return;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0)
+    {
+        return;
+    }
+
+    size = st.st_size;
+    // nanoseconds, so edits within the same second still change the stamp
+#ifdef __APPLE__
+    modifiedTime = (uint64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    modifiedTime = (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    open = true;
+
+    if (size == 0)
+    {
+        return;
+    }
+
+    void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (p != MAP_FAILED)
+    {
+        data = (const char*)p;
+        madvise(p, size, MADV_SEQUENTIAL);
+    }
+
+    open = data != nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+    if (data != nullptr)
+    {
+        munmap((void*)data, size);
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+#endif
+
+bool MappedFile::isOpen() const
+{
+    return open;
+}
+
+const char* MappedFile::getData() const
+{
+    return data;
+}
+
+size_t MappedFile::getSize() const
+{
+    return size;
+}
+
+uint64_t MappedFile::getModifiedTime() const
+{
+    return modifiedTime;
+}
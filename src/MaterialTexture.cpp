@@ -0,0 +1,135 @@
+#include "MaterialTexture.hpp"
+#include "Utils.hpp"
+#include "GammaTable.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+MaterialSample MaterialSample::operator+(const MaterialSample& b) const
+{
+    MaterialSample r;
+
+    r.albedo = albedo + b.albedo;
+    r.emission = emission + b.emission;
+    r.normal = normal + b.normal;
+    r.metallic = metallic + b.metallic;
+    r.roughness = roughness + b.roughness;
+    r.ao = ao + b.ao;
+
+    return r;
+}
+
+MaterialSample MaterialSample::operator-(const MaterialSample& b) const
+{
+    MaterialSample r;
+
+    r.albedo = albedo - b.albedo;
+    r.emission = emission - b.emission;
+    r.normal = normal - b.normal;
+    r.metallic = metallic - b.metallic;
+    r.roughness = roughness - b.roughness;
+    r.ao = ao - b.ao;
+
+    return r;
+}
+
+MaterialSample MaterialSample::operator*(const float t) const
+{
+    MaterialSample r;
+
+    r.albedo = albedo * t;
+    r.emission = emission * t;
+    r.normal = normal * t;
+    r.metallic = metallic * t;
+    r.roughness = roughness * t;
+    r.ao = ao * t;
+
+    return r;
+}
+
+MaterialTexture::MaterialTexture(Texture& diffuse, NormalTexture& normal, MonoTexture& metallic,
+                                 MonoTexture& roughness, MonoTexture& ao, Texture& emission,
+                                 ThreadPool& pool)
+{
+    width = std::max({diffuse.getWidth(), normal.getWidth(), metallic.getWidth(),
+                      roughness.getWidth(), ao.getWidth(), emission.getWidth()});
+    height = std::max({diffuse.getHeight(), normal.getHeight(), metallic.getHeight(),
+                       roughness.getHeight(), ao.getHeight(), emission.getHeight()});
+
+    printf("Packed material:\nwidth: %d height: %d\n\n", width, height);
+
+    texels.resize(mips.Init(width, height));
+
+    // texel centers at (i + 0.5) / size, as in MipChain, so equally sized inputs
+    // are copied exactly and smaller ones are sampled where their texels lie
+    pool.Run(height, [&](int y)
+    {
+        const float v = (y + 0.5f) / height;
+
+        for (unsigned x = 0; x < width; ++x)
+        {
+            const float u = (x + 0.5f) / width;
+
+            MaterialTexel& t = texels[mips.Index(0, x, y)];
+
+            const glm::u8vec3 albedo(glm::round(diffuse.getCol(u, v) * 255.0f));
+
+            t.albedo = glm::u16vec3(GammaTable::Decode(albedo.x), GammaTable::Decode(albedo.y),
+                                    GammaTable::Decode(albedo.z));
+            t.emission = glm::u8vec3(glm::round(emission.getCol(u, v) * 255.0f));
+            t.normal = Utils::PackNormal(normal.getNormal(u, v));
+            t.metallic = std::round(metallic.getVal(u, v) * 255.0f);
+            t.roughness = std::round(roughness.getVal(u, v) * 255.0f);
+            t.ao = std::round(ao.getVal(u, v) * 255.0f);
+        }
+    });
+
+    mips.Build(texels, average, &pool);
+}
+
+MaterialSample MaterialTexture::getSample(float x, float y)
+{
+    return mips.SampleNearest<MaterialSample>(x, y, [this](size_t i) { return fetch(i); });
+}
+
+MaterialSample MaterialTexture::getSample(float x, float y, float lod)
+{
+    return mips.SampleTrilinear<MaterialSample>(x, y, lod, [this](size_t i) { return fetch(i); });
+}
+
+MaterialSample MaterialTexture::fetch(const size_t i) const
+{
+    const MaterialTexel& t = texels[i];
+
+    MaterialSample s;
+
+    s.albedo = glm::vec3(t.albedo) * (1.0f / 65535.0f);
+    s.emission = glm::vec3(t.emission) / 255.0f;
+    s.normal = Utils::UnpackNormal(t.normal);
+    s.metallic = t.metallic / 255.0f;
+    s.roughness = t.roughness / 255.0f;
+    s.ao = t.ao / 255.0f;
+
+    return s;
+}
+
+MaterialTexel MaterialTexture::average(const MaterialTexel& a, const MaterialTexel& b,
+                                       const MaterialTexel& c, const MaterialTexel& d)
+{
+    MaterialTexel r;
+
+    r.albedo = glm::u16vec3((glm::uvec3(a.albedo) + glm::uvec3(b.albedo) +
+                             glm::uvec3(c.albedo) + glm::uvec3(d.albedo) + 2u) / 4u);
+    r.emission = glm::u8vec3((glm::uvec3(a.emission) + glm::uvec3(b.emission) +
+                              glm::uvec3(c.emission) + glm::uvec3(d.emission) + 2u) / 4u);
+    r.metallic = (a.metallic + b.metallic + c.metallic + d.metallic + 2) / 4;
+    r.roughness = (a.roughness + b.roughness + c.roughness + d.roughness + 2) / 4;
+    r.ao = (a.ao + b.ao + c.ao + d.ao + 2) / 4;
+
+    const glm::vec3 n = Utils::UnpackNormal(a.normal) + Utils::UnpackNormal(b.normal) +
+        Utils::UnpackNormal(c.normal) + Utils::UnpackNormal(d.normal);
+
+    r.normal = Utils::PackNormal(glm::dot(n, n) > 0.0f ? n : glm::vec3(0.0f, 0.0f, 1.0f));
+
+    return r;
+}
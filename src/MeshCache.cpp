@@ -0,0 +1,268 @@
+#include "MeshCache.hpp"
+
+#include "MappedFile.hpp"
+#include "MeshCodec.hpp"
+#include "Model.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    const char cacheMagic[8] = {'A', 'K', 'G', 'M', 'E', 'S', 'H', '\0'};
+}
+
+std::string MeshCache::CacheFilename(const std::string& source)
+{
+    const size_t dot = source.find_last_of('.');
+    const size_t slash = source.find_last_of("/\\");
+
+    // only an extension of the file name itself is replaced
+    const bool hasExtension = dot != std::string::npos &&
+        (slash == std::string::npos || dot > slash);
+
+    return (hasExtension ? source.substr(0, dot) : source) + ".akgmesh";
+}
+
+bool MeshCache::Load(const std::string& filename, const Stamp& stamp, Model& model,
+                     ThreadPool& pool)
+{
+    MappedFile file(filename);
+
+    if (!file.isOpen() || file.getSize() < sizeof(Header))
+    {
+        return false;
+    }
+
+    const char *data = file.getData();
+
+    Header header;
+
+    memcpy(&header, data, sizeof(Header));
+
+    const bool current = memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 &&
+        header.version == version &&
+        header.stamp.sourceSize == stamp.sourceSize &&
+        header.stamp.sourceTime == stamp.sourceTime &&
+        header.stamp.flags == stamp.flags;
+
+    if (!current || header.vertexCount < 0 || header.faceCount < 0 ||
+        header.clusterCount < 0 || header.dependencyCount < 0)
+    {
+        return false;
+    }
+
+    // the offsets must be the ones this version would write
+    Header expected = header;
+
+    layout(expected);
+
+    if (memcmp(expected.offsets, header.offsets, sizeof(header.offsets)) != 0 ||
+        expected.fileSize != header.fileSize || header.fileSize != file.getSize())
+    {
+        return false;
+    }
+
+    // the renderer indexes with these without checks
+    const ClusterRecord *records = (const ClusterRecord*)(data + header.offsets[5]);
+    const int32_t *dependencies = (const int32_t*)(data + header.offsets[6]);
+
+    for (int i = 0; i < header.clusterCount; ++i)
+    {
+        const ClusterRecord& r = records[i];
+
+        const bool valid = r.firstFace >= 0 && r.faceCount >= 0 &&
+            r.firstFace <= header.faceCount - r.faceCount &&
+            r.vertexBegin >= 0 && r.vertexBegin <= r.vertexEnd &&
+            r.vertexEnd <= header.vertexCount &&
+            r.firstDependency >= 0 && r.dependencyCount >= 0 &&
+            r.firstDependency <= header.dependencyCount - r.dependencyCount;
+
+        if (!valid)
+        {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < header.dependencyCount; ++i)
+    {
+        if (dependencies[i] < 0 || dependencies[i] >= header.clusterCount)
+        {
+            return false;
+        }
+    }
+
+    model.clusters.resize(header.clusterCount);
+
+    for (int i = 0; i < header.clusterCount; ++i)
+    {
+        const ClusterRecord& r = records[i];
+        Cluster& cl = model.clusters[i];
+
+        cl.firstFace = r.firstFace;
+        cl.faceCount = r.faceCount;
+        cl.vertexBegin = r.vertexBegin;
+        cl.vertexEnd = r.vertexEnd;
+        cl.dependencies.assign(dependencies + r.firstDependency,
+                               dependencies + r.firstDependency + r.dependencyCount);
+        cl.center = glm::vec3(r.center[0], r.center[1], r.center[2]);
+        cl.radius = r.radius;
+        cl.coneAxis = glm::vec3(r.coneAxis[0], r.coneAxis[1], r.coneAxis[2]);
+        cl.coneCutoff = r.coneCutoff;
+    }
+
+    if (header.encodedBytes > 0)
+    {
+        return MeshCodec::Decode(data + header.offsets[7], header.encodedBytes, model, pool) &&
+            (int)model.vertices.size() == header.vertexCount &&
+            (int)model.faces.size() == header.faceCount;
+    }
+
+    const Face *faces = (const Face*)(data + header.offsets[4]);
+
+    for (int i = 0; i < header.faceCount; ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            if (faces[i].vertices[k] < 0 || faces[i].vertices[k] >= header.vertexCount)
+            {
+                return false;
+            }
+        }
+    }
+
+    const glm::vec3 *vertices = (const glm::vec3*)(data + header.offsets[0]),
+        *normals = (const glm::vec3*)(data + header.offsets[1]),
+        *tangents = (const glm::vec3*)(data + header.offsets[2]);
+    const glm::vec2 *uvs = (const glm::vec2*)(data + header.offsets[3]);
+
+    model.vertices.assign(vertices, vertices + header.vertexCount);
+    model.normals.assign(normals, normals + header.vertexCount);
+    model.tangents.assign(tangents, tangents + header.vertexCount);
+    model.uvs.assign(uvs, uvs + header.vertexCount);
+    model.faces.assign(faces, faces + header.faceCount);
+
+    return true;
+}
+
+bool MeshCache::Save(const std::string& filename, const Stamp& stamp, const Model& model)
+{
+    Header header = Header();
+
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = version;
+    header.stamp = stamp;
+    header.vertexCount = model.vertices.size();
+    header.faceCount = model.faces.size();
+    header.clusterCount = model.clusters.size();
+
+    std::vector<ClusterRecord> records(model.clusters.size());
+    std::vector<int32_t> dependencies;
+
+    for (size_t i = 0; i < model.clusters.size(); ++i)
+    {
+        const Cluster& cl = model.clusters[i];
+        ClusterRecord& r = records[i];
+
+        r.firstFace = cl.firstFace;
+        r.faceCount = cl.faceCount;
+        r.vertexBegin = cl.vertexBegin;
+        r.vertexEnd = cl.vertexEnd;
+        r.firstDependency = dependencies.size();
+        r.dependencyCount = cl.dependencies.size();
+
+        for (int k = 0; k < 3; ++k)
+        {
+            r.center[k] = cl.center[k];
+            r.coneAxis[k] = cl.coneAxis[k];
+        }
+
+        r.radius = cl.radius;
+        r.coneCutoff = cl.coneCutoff;
+
+        dependencies.insert(dependencies.end(), cl.dependencies.begin(), cl.dependencies.end());
+    }
+
+    header.dependencyCount = dependencies.size();
+
+    // models whose faces MeshCodec cannot code are stored as is
+    std::vector<char> encoded;
+
+    if ((stamp.flags & Compressed) && MeshCodec::Encode(model, encoded))
+    {
+        header.encodedBytes = encoded.size();
+    }
+
+    layout(header);
+
+    const void *arrays[arrayCount] = {model.vertices.data(), model.normals.data(),
+                                      model.tangents.data(), model.uvs.data(),
+                                      model.faces.data(), records.data(),
+                                      dependencies.data(), encoded.data()};
+
+    FILE *file = fopen(filename.c_str(), "wb");
+
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    const char padding[alignment] = {};
+
+    bool written = fwrite(&header, sizeof(Header), 1, file) == 1;
+    size_t offset = sizeof(Header);
+
+    for (int i = 0; i < arrayCount && written; ++i)
+    {
+        const size_t pad = header.offsets[i] - offset,
+            bytes = arrayBytes(header, i);
+
+        written = fwrite(padding, 1, pad, file) == pad &&
+            fwrite(arrays[i], 1, bytes, file) == bytes;
+
+        offset = header.offsets[i] + bytes;
+    }
+
+    written = fclose(file) == 0 && written;
+
+    // a partial file would fail the size check, but is removed right away
+    if (!written)
+    {
+        remove(filename.c_str());
+    }
+
+    return written;
+}
+
+void MeshCache::layout(Header& header)
+{
+    size_t offset = sizeof(Header);
+
+    for (int i = 0; i < arrayCount; ++i)
+    {
+        offset = (offset + alignment - 1) / alignment * alignment;
+
+        header.offsets[i] = offset;
+        offset += arrayBytes(header, i);
+    }
+
+    header.fileSize = offset;
+}
+
+size_t MeshCache::arrayBytes(const Header& header, const int array)
+{
+    const size_t elementBytes[arrayCount] = {sizeof(glm::vec3), sizeof(glm::vec3),
+                                             sizeof(glm::vec3), sizeof(glm::vec2),
+                                             sizeof(Face), sizeof(ClusterRecord),
+                                             sizeof(int32_t), 1};
+
+    // encoded models keep only their clusters as is
+    const size_t vertexCount = header.encodedBytes > 0 ? 0 : header.vertexCount,
+        faceCount = header.encodedBytes > 0 ? 0 : header.faceCount;
+
+    const size_t counts[arrayCount] = {vertexCount, vertexCount, vertexCount, vertexCount,
+                                       faceCount, (size_t)header.clusterCount,
+                                       (size_t)header.dependencyCount, header.encodedBytes};
+
+    return elementBytes[array] * counts[array];
+}
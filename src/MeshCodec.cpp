@@ -0,0 +1,268 @@
+#include "MeshCodec.hpp"
+
+#include "Model.hpp"
+#include "Utils.hpp"
+
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+    // 16 bit grid over [lo, hi] per component
+    template<int N>
+    void calcRange(const glm::vec<N, float>* src, const size_t count, float offset[N],
+                   float scale[N])
+    {
+        for (int k = 0; k < N; ++k)
+        {
+            float lo = FLT_MAX, hi = -FLT_MAX;
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                lo = std::min(lo, src[i][k]);
+                hi = std::max(hi, src[i][k]);
+            }
+
+            offset[k] = count > 0 ? lo : 0.0f;
+            scale[k] = count > 0 ? (hi - lo) / 65535.0f : 0.0f;
+        }
+    }
+
+    template<int N>
+    glm::vec<N, uint16_t> quantize(const glm::vec<N, float> v, const float offset[N],
+                                   const float scale[N])
+    {
+        glm::vec<N, uint16_t> q;
+
+        for (int k = 0; k < N; ++k)
+        {
+            const float t = scale[k] > 0.0f ? (v[k] - offset[k]) / scale[k] : 0.0f;
+
+            q[k] = std::min(std::max(std::round(t), 0.0f), 65535.0f);
+        }
+
+        return q;
+    }
+
+    template<int N>
+    glm::vec<N, float> dequantize(const glm::vec<N, uint16_t> q, const float offset[N],
+                                  const float scale[N])
+    {
+        glm::vec<N, float> v;
+
+        for (int k = 0; k < N; ++k)
+        {
+            v[k] = offset[k] + q[k] * scale[k];
+        }
+
+        return v;
+    }
+}
+
+bool MeshCodec::Encode(const Model& model, std::vector<char>& data)
+{
+    Header header = Header();
+
+    header.vertexCount = model.vertices.size();
+    header.faceCount = model.faces.size();
+    header.clusterCount = model.clusters.size();
+
+    calcRange<3>(model.vertices.data(), model.vertices.size(), header.positionOffset,
+                 header.positionScale);
+    calcRange<2>(model.uvs.data(), model.uvs.size(), header.uvOffset, header.uvScale);
+
+    std::vector<char> indices;
+    std::vector<uint32_t> indexStarts;
+
+    for (const Cluster& cl : model.clusters)
+    {
+        int next = cl.vertexBegin;
+
+        indexStarts.push_back(indices.size());
+
+        for (int i = cl.firstFace; i < cl.firstFace + cl.faceCount; ++i)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                const int v = model.faces[i].vertices[k];
+
+                if (v > next || v < 0)
+                {
+                    return false;
+                }
+
+                writeVarint(next - v, indices);
+                next += v == next;
+            }
+        }
+    }
+
+    indexStarts.push_back(indices.size());
+
+    header.indexBytes = indices.size();
+
+    size_t offsets[sectionCount];
+
+    data.assign(layout(header, offsets), 0);
+
+    memcpy(data.data(), &header, sizeof(Header));
+
+    glm::u16vec3 *positions = (glm::u16vec3*)(data.data() + offsets[0]);
+    glm::u16vec2 *uvs = (glm::u16vec2*)(data.data() + offsets[1]),
+        *normals = (glm::u16vec2*)(data.data() + offsets[2]),
+        *tangents = (glm::u16vec2*)(data.data() + offsets[3]);
+
+    for (int i = 0; i < header.vertexCount; ++i)
+    {
+        positions[i] = quantize<3>(model.vertices[i], header.positionOffset,
+                                   header.positionScale);
+        uvs[i] = quantize<2>(model.uvs[i], header.uvOffset, header.uvScale);
+        normals[i] = Utils::PackNormal(model.normals[i]);
+        tangents[i] = Utils::PackNormal(model.tangents[i]);
+    }
+
+    memcpy(data.data() + offsets[4], indexStarts.data(), indexStarts.size() * sizeof(uint32_t));
+    memcpy(data.data() + offsets[5], indices.data(), indices.size());
+
+    return true;
+}
+
+bool MeshCodec::Decode(const char* data, const size_t size, Model& model, ThreadPool& pool)
+{
+    if (size < sizeof(Header))
+    {
+        return false;
+    }
+
+    Header header;
+
+    memcpy(&header, data, sizeof(Header));
+
+    size_t offsets[sectionCount];
+
+    if (header.vertexCount < 0 || header.faceCount < 0 ||
+        header.clusterCount != (int)model.clusters.size() || layout(header, offsets) != size)
+    {
+        return false;
+    }
+
+    const glm::u16vec3 *positions = (const glm::u16vec3*)(data + offsets[0]);
+    const glm::u16vec2 *uvs = (const glm::u16vec2*)(data + offsets[1]),
+        *normals = (const glm::u16vec2*)(data + offsets[2]),
+        *tangents = (const glm::u16vec2*)(data + offsets[3]);
+    const uint32_t *indexStarts = (const uint32_t*)(data + offsets[4]);
+    const uint8_t *indices = (const uint8_t*)(data + offsets[5]);
+
+    const int vertexCount = header.vertexCount;
+
+    model.vertices.resize(vertexCount);
+    model.uvs.resize(vertexCount);
+    model.normals.resize(vertexCount);
+    model.tangents.resize(vertexCount);
+    model.faces.assign(header.faceCount, Face(glm::ivec3(0)));
+
+    pool.Run((vertexCount + batchSize - 1) / batchSize, [&](int job)
+    {
+        const int end = std::min((job + 1) * batchSize, vertexCount);
+
+        for (int i = job * batchSize; i < end; ++i)
+        {
+            model.vertices[i] = dequantize<3>(positions[i], header.positionOffset,
+                                              header.positionScale);
+            model.uvs[i] = dequantize<2>(uvs[i], header.uvOffset, header.uvScale);
+            model.normals[i] = Utils::UnpackNormal(normals[i]);
+            model.tangents[i] = Utils::UnpackNormal(tangents[i]);
+        }
+    });
+
+    // clusters decode independently, each starting from its own first vertex
+    std::vector<uint8_t> decoded(header.clusterCount, 0);
+
+    pool.Run(header.clusterCount, [&](int id)
+    {
+        const Cluster& cl = model.clusters[id];
+
+        if (indexStarts[id] > indexStarts[id + 1] || indexStarts[id + 1] > header.indexBytes ||
+            cl.firstFace < 0 || cl.faceCount < 0 || cl.firstFace > header.faceCount - cl.faceCount)
+        {
+            return;
+        }
+
+        const uint8_t *p = indices + indexStarts[id],
+            *end = indices + indexStarts[id + 1];
+
+        int next = cl.vertexBegin;
+
+        for (int i = cl.firstFace; i < cl.firstFace + cl.faceCount; ++i)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t delta = 0;
+                int shift = 0;
+
+                do
+                {
+                    if (p == end || shift > 28)
+                    {
+                        return;
+                    }
+
+                    delta |= (uint32_t)(*p & 0x7F) << shift;
+                    shift += 7;
+                }
+                while (*p++ & 0x80);
+
+                const int64_t v = (int64_t)next - delta;
+
+                if (v < 0 || v >= vertexCount)
+                {
+                    return;
+                }
+
+                model.faces[i].vertices[k] = v;
+                next += delta == 0;
+            }
+        }
+
+        decoded[id] = p == end;
+    });
+
+    return std::find(decoded.begin(), decoded.end(), 0) == decoded.end();
+}
+
+size_t MeshCodec::layout(const Header& header, size_t offsets[sectionCount])
+{
+    const size_t vertexCount = header.vertexCount;
+    const size_t bytes[sectionCount] = {vertexCount * sizeof(glm::u16vec3),
+                                        vertexCount * sizeof(glm::u16vec2),
+                                        vertexCount * sizeof(glm::u16vec2),
+                                        vertexCount * sizeof(glm::u16vec2),
+                                        (header.clusterCount + 1) * sizeof(uint32_t),
+                                        header.indexBytes};
+
+    size_t offset = sizeof(Header);
+
+    for (int i = 0; i < sectionCount; ++i)
+    {
+        // 16 byte aligned sections
+        offset = (offset + 15) & ~(size_t)15;
+
+        offsets[i] = offset;
+        offset += bytes[i];
+    }
+
+    return offset;
+}
+
+void MeshCodec::writeVarint(uint32_t v, std::vector<char>& out)
+{
+    while (v >= 0x80)
+    {
+        out.push_back((char)((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+
+    out.push_back((char)v);
+}
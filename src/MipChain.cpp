@@ -0,0 +1,39 @@
+#include "MipChain.hpp"
+
+size_t MipChain::Init(const int width, const int height)
+{
+    levels.clear();
+
+    MipLevel level;
+    level.width = width;
+    level.height = height;
+    level.offset = 0;
+
+    size_t size = 0;
+
+    while (true)
+    {
+        // levels are padded to whole tiles
+        const int tilesX = (level.width + tileMask) >> tileShift,
+            tilesY = (level.height + tileMask) >> tileShift;
+
+        level.tileRowTexels = static_cast<size_t>(tilesX) << (tileShift * 2);
+        level.offset = size;
+
+        levels.push_back(level);
+
+        size += level.tileRowTexels * tilesY;
+
+        if (level.width <= 1 && level.height <= 1)
+        {
+            break;
+        }
+
+        level.width = std::max(level.width / 2, 1);
+        level.height = std::max(level.height / 2, 1);
+    }
+
+    sizeLog2 = std::log2(static_cast<float>(std::max(width, height)));
+
+    return size;
+}
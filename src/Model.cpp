@@ -1,283 +1,1338 @@
 #include "Model.hpp"
 
-#include <fstream>
+#include "MappedFile.hpp"
+#include "MeshCache.hpp"
+#include "Utils.hpp"
+
 #include <cstdio>
+#include <cstring>
+#include <cfloat>
+#include <charconv>
+#include <string_view>
+#include <algorithm>
+
+Model::Model(const std::string& filename, const bool optimize, const bool compress,
+             ThreadPool& pool)
+{
+    positionOffset = glm::vec3(0.0f);
+    positionScale = glm::vec3(0.0f);
+
+    MappedFile file(filename);
+
+    if (!file.isOpen())
+    {
+        return;
+    }
+
+    // processed models are cached next to the source, keyed on its size and write time
+    const std::string cacheName = MeshCache::CacheFilename(filename);
+    const MeshCache::Stamp stamp = {file.getSize(), file.getModifiedTime(),
+                                    (optimize ? MeshCache::Optimized : 0u) |
+                                    (compress ? MeshCache::Compressed : 0u)};
+
+    if (MeshCache::Load(cacheName, stamp, *this, pool))
+    {
+        printf("Loaded model from %s. Vertices: %d, triangles: %d, clusters: %d\n",
+               cacheName.c_str(), (int)vertices.size(), (int)faces.size(),
+               (int)clusters.size());
+        return;
+    }
+
+    const char *begin = file.getData(),
+        *end = begin + file.getSize();
+
+    std::vector<ObjChunk> chunks;
+
+    for (const char *p = begin; p < end;)
+    {
+        ObjChunk chunk = ObjChunk();
+        chunk.begin = p;
+
+        if ((size_t)(end - p) > chunkBytes)
+        {
+            const char *lineEnd = lineEndOf(p + chunkBytes, end);
+
+            chunk.end = lineEnd == end ? end : lineEnd + 1;
+        }
+        else
+        {
+            chunk.end = end;
+        }
+
+        p = chunk.end;
+        chunks.push_back(chunk);
+    }
+
+    pool.Run(chunks.size(), [&chunks](int i)
+    {
+        chunks[i].counts = countElements(chunks[i].begin, chunks[i].end);
+    });
+
+    // each chunk writes its attributes after those of the chunks before it
+    ObjCounts counts = ObjCounts();
+
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.vertices = counts.vertices;
+        chunk.uvs = counts.uvs;
+        chunk.normals = counts.normals;
+
+        counts.vertices += chunk.counts.vertices;
+        counts.uvs += chunk.counts.uvs;
+        counts.normals += chunk.counts.normals;
+        counts.faces += chunk.counts.faces;
+        counts.corners += chunk.counts.corners;
+    }
+
+    vertices.resize(counts.vertices);
+    uvs.resize(counts.uvs);
+    normals.resize(counts.normals);
+
+    pool.Run(chunks.size(), [this, &chunks](int i) { chunks[i].parsed = parseChunk(chunks[i]); });
+
+    // the model ends at the first malformed line, later chunks are dropped
+    size_t chunkCount = 0;
+
+    while (chunkCount < chunks.size() && chunks[chunkCount].parsed)
+    {
+        ++chunkCount;
+    }
+
+    const bool parsed = chunkCount == chunks.size();
+
+    if (!parsed)
+    {
+        const ObjChunk& failed = chunks[chunkCount++];
+
+        vertices.resize(failed.vertices);
+        uvs.resize(failed.uvs);
+        normals.resize(failed.normals);
+
+        printf("Model parsing failed\n");
+    }
+
+    // position, uv and normal indices of every face corner, resolved to 0-based
+    std::vector<size_t> firstCorner(chunkCount + 1, 0);
+
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        firstCorner[i + 1] = firstCorner[i] + chunks[i].corners.size();
+    }
+
+    std::vector<glm::ivec3> corners(firstCorner[chunkCount]);
+
+    pool.Run(chunkCount, [&chunks, &firstCorner, &corners](int i)
+    {
+        std::copy(chunks[i].corners.begin(), chunks[i].corners.end(),
+                  corners.begin() + firstCorner[i]);
+        chunks[i].corners = std::vector<glm::ivec3>();
+    });
+
+    centerModel(pool);
+
+    // a face referencing a position that does not exist fails the whole model
+    if (!weldVertices(corners))
+    {
+        if (parsed)
+        {
+            printf("Model parsing failed\n");
+        }
+
+        vertices.clear();
+        normals.clear();
+        uvs.clear();
+        faces.clear();
+        return;
+    }
 
-Model::Model(const std::string& filename)
+    calcTangents(pool);
+
+    const float acmr = calcACMR(cacheSize);
+
+    buildClusters(optimize);
+
+    printf("Loaded model. Vertices: %d, faces: %d\n", counts.vertices, counts.faces);
+    printf("Texture coords: %d, normals: %d\n", counts.uvs, counts.normals);
+    printf("Welded vertices: %d, clusters: %d\n", (int)vertices.size(),
+           (int)clusters.size());
+
+    if (optimize)
+    {
+        printf("ACMR (%d entry FIFO): %.3f, reordered: %.3f\n", cacheSize, acmr,
+               calcACMR(cacheSize));
+    }
+    else
+    {
+        printf("ACMR (%d entry FIFO): %.3f\n", cacheSize, acmr);
+    }
+
+    // a partly parsed model is not cached, so the error shows again next time
+    if (!parsed)
+    {
+        return;
+    }
+
+    if (!MeshCache::Save(cacheName, stamp, *this))
+    {
+        printf("Could not write %s\n", cacheName.c_str());
+    }
+}
+
+void Model::getVertices(const Face f, Vertex& a, Vertex& b, Vertex& c)
+{
+    Vertex* const res[3] = {&a, &b, &c};
+
+    for (int i = 0; i < 3; ++i)
+    {
+        const int v = f.vertices[i];
+
+        if (isQuantized())
+        {
+            res[i]->v = positionOffset + glm::vec3(packedVertices[v]) * positionScale;
+            res[i]->n = Utils::UnpackNormal(packedNormals[v]);
+            res[i]->t = glm::unpackHalf2x16(packedUVs[v]);
+            res[i]->tangent = Utils::UnpackNormal(packedTangents[v]);
+        }
+        else
+        {
+            res[i]->v = vertices[v];
+            res[i]->n = normals[v];
+            res[i]->t = uvs[v];
+            res[i]->tangent = tangents[v];
+        }
+    }
+}
+
+int Model::getVertexCount() const
+{
+    return isQuantized() ? packedVertices.size() : vertices.size();
+}
+
+bool Model::isQuantized() const
 {
-    std::ifstream file(filename);
+    return !packedVertices.empty();
+}
+
+void Model::quantizeAttributes(ThreadPool& pool)
+{
+    const int count = vertices.size(),
+        jobs = (count + batchSize - 1) / batchSize;
 
-    if (!file.is_open())
+    if (count == 0)
     {
         return;
     }
 
-    std::string s;
-    int vCount = 0, fCount = 0, tCount = 0, nCount = 0;
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
 
-    while (file >> s)
+    for (const glm::vec3 v : vertices)
     {
-        if (s == "v")
+        lo = glm::min(lo, v);
+        hi = glm::max(hi, v);
+    }
+
+    positionOffset = lo;
+    positionScale = (hi - lo) / 65535.0f;
+
+    // flat axes map to 0
+    const glm::vec3 invScale(positionScale.x > 0.0f ? 1.0f / positionScale.x : 0.0f,
+                             positionScale.y > 0.0f ? 1.0f / positionScale.y : 0.0f,
+                             positionScale.z > 0.0f ? 1.0f / positionScale.z : 0.0f);
+
+    packedVertices.resize(count);
+    packedNormals.resize(count);
+    packedTangents.resize(count);
+    packedUVs.resize(count);
+
+    pool.Run(jobs, [this, invScale, count](int job)
+    {
+        const int end = std::min((job + 1) * batchSize, count);
+
+        for (int i = job * batchSize; i < end; ++i)
         {
-            ++vCount;
+            const glm::vec3 q = glm::round((vertices[i] - positionOffset) * invScale);
 
-            loadVertex(file);
+            packedVertices[i] = glm::u16vec3(glm::clamp(q, glm::vec3(0.0f), glm::vec3(65535.0f)));
+            packedNormals[i] = Utils::PackNormal(normals[i]);
+            packedTangents[i] = Utils::PackNormal(tangents[i]);
+            packedUVs[i] = glm::packHalf2x16(uvs[i]);
         }
-        else if (s == "vt")
+    });
+
+    vertices = std::vector<glm::vec3>();
+    normals = std::vector<glm::vec3>();
+    tangents = std::vector<glm::vec3>();
+    uvs = std::vector<glm::vec2>();
+}
+
+bool Model::weldVertices(const std::vector<glm::ivec3>& corners)
+{
+    const std::vector<glm::vec3> positions(std::move(vertices)), fileNormals(std::move(normals));
+    const std::vector<glm::vec2> fileUVs(std::move(uvs));
+
+    vertices.clear();
+    normals.clear();
+    uvs.clear();
+
+    // welded vertices sharing each position, as a linked list through next
+    std::vector<int> head(positions.size(), -1), next;
+    std::vector<glm::ivec2> keys;
+
+    faces.clear();
+    faces.reserve(corners.size() / 3);
+
+    glm::ivec3 face;
+
+    for (size_t i = 0; i < corners.size(); ++i)
+    {
+        const glm::ivec3 c = corners[i];
+        const glm::ivec2 key(c[1], c[2]);
+
+        if (c[0] < 0 || (size_t)c[0] >= positions.size())
         {
-            ++tCount;
+            return false;
+        }
 
-            loadTextureCoords(file);
+        int v = head[c[0]];
+
+        while (v >= 0 && keys[v] != key)
+        {
+            v = next[v];
         }
-        else if (s == "vn")
+
+        if (v < 0)
         {
-            ++nCount;
+            v = vertices.size();
+
+            vertices.push_back(positions[c[0]]);
+            // a face with no uv or normal index gets zeros
+            uvs.push_back((size_t)c[1] < fileUVs.size() ? fileUVs[c[1]] : glm::vec2(0.0f));
+            normals.push_back((size_t)c[2] < fileNormals.size() ? fileNormals[c[2]]
+                                                                : glm::vec3(0.0f));
+
+            keys.push_back(key);
+            next.push_back(head[c[0]]);
+            head[c[0]] = v;
+        }
+
+        face[i % 3] = v;
+
+        if (i % 3 == 2)
+        {
+            faces.push_back(Face(face));
+        }
+    }
+
+    return true;
+}
+
+Model::ObjCounts Model::countElements(const char* p, const char* end)
+{
+    ObjCounts counts = ObjCounts();
+
+    while (p < end)
+    {
+        const char *lineEnd = lineEndOf(p, end);
+        const std::string_view s = lineKeyword(p, lineEnd);
+
+        // must match parseChunk, chunks write their attributes at these offsets
+        counts.vertices += s == "v";
+        counts.uvs += s == "vt";
+        counts.normals += s == "vn";
+
+        if (s == "f")
+        {
+            // a fourth corner makes a second triangle, later ones are ignored
+            int tokens = 0;
+
+            for (const char *c = p; c < lineEnd; ++c)
+            {
+                tokens += isSpace(c[-1]) && !isSpace(c[0]);
+            }
+
+            ++counts.faces;
+            counts.corners += tokens > 3 ? 6 : 3;
+        }
+
+        p = lineEnd + 1;
+    }
+
+    return counts;
+}
+
+bool Model::parseChunk(ObjChunk& chunk)
+{
+    chunk.corners.reserve(chunk.counts.corners);
+
+    const char *p = chunk.begin;
+
+    while (p < chunk.end)
+    {
+        const char *lineEnd = lineEndOf(p, chunk.end);
+        const std::string_view s = lineKeyword(p, lineEnd);
 
-            loadNormal(file);
+        bool parsed = true;
+
+        if (s == "v")
+        {
+            parsed = loadVertex(p, lineEnd, chunk);
+        }
+        else if (s == "vt")
+        {
+            parsed = loadTextureCoords(p, lineEnd, chunk);
+        }
+        else if (s == "vn")
+        {
+            parsed = loadNormal(p, lineEnd, chunk);
         }
         else if (s == "f")
         {
-            ++fCount;
+            parsed = loadFace(p, lineEnd, chunk);
+        }
 
-            loadFace(file);
+        if (!parsed)
+        {
+            return false;
         }
 
-        if (!file && !file.eof())
+        // the rest of the line is ignored
+        p = lineEnd + 1;
+    }
+
+    return true;
+}
+
+bool Model::loadVertex(const char*& p, const char* end, ObjChunk& chunk)
+{
+    glm::vec3 v;
+
+    // w is ignored
+    if (!parseFloat(p, end, v.x) || !parseFloat(p, end, v.y) || !parseFloat(p, end, v.z))
+    {
+        return false;
+    }
+
+    vertices[chunk.vertices++] = v;
+    return true;
+}
+
+bool Model::loadFace(const char*& p, const char* end, ObjChunk& chunk)
+{
+    std::vector<glm::ivec3>& corners = chunk.corners;
+    glm::ivec3 a, b, c, d;
+
+    if (!loadFaceVertex(p, end, chunk, a) || !loadFaceVertex(p, end, chunk, b) ||
+        !loadFaceVertex(p, end, chunk, c))
+    {
+        return false;
+    }
+
+    corners.push_back(a);
+    corners.push_back(b);
+    corners.push_back(c);
+
+    skipSpaces(p, end);
+
+    const bool hasFourthVertex = p < end;
+
+    // quad face
+    if (hasFourthVertex)
+    {
+        if (!loadFaceVertex(p, end, chunk, d))
+        {
+            return false;
+        }
+
+        corners.push_back(a);
+        corners.push_back(c);
+        corners.push_back(d);
+    }
+
+    return true;
+}
+
+bool Model::loadFaceVertex(const char*& p, const char* end, const ObjChunk& chunk,
+                           glm::ivec3& v)
+{
+    // vertex, texture, normal indices, 0 where missing
+    v = glm::ivec3(0);
+
+    bool parsed = parseInt(p, end, v[0]);
+
+    if (parsed && p < end && *p == '/')
+    {
+        ++p;
+
+        // normal with no texture
+        if (p < end && *p == '/')
+        {
+            ++p;
+            parsed = parseInt(p, end, v[2]);
+        }
+        else
+        {
+            // texture
+            parsed = parseInt(p, end, v[1]);
+
+            if (parsed && p < end && *p == '/')
+            {
+                // normal
+                ++p;
+                parsed = parseInt(p, end, v[2]);
+            }
+        }
+    }
+
+    // 1-based, negative ones count back from the last element read so far,
+    // including those in earlier chunks
+    v[0] = resolveIndex(v[0], chunk.vertices);
+    v[1] = resolveIndex(v[1], chunk.uvs);
+    v[2] = resolveIndex(v[2], chunk.normals);
+
+    return parsed;
+}
+
+int Model::resolveIndex(const int i, const int count)
+{
+    // -1 for a missing index
+    return i > 0 ? i - 1 : (i < 0 ? count + i : -1);
+}
+
+bool Model::parseFloat(const char*& p, const char* end, float& v)
+{
+    static const float powersOf10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                                       1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+    skipSpaces(p, end);
+
+    const char *start = p;
+    const bool negative = p < end && *p == '-';
+
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        ++p;
+    }
+
+    // plain decimals with few digits are exact as one float division,
+    // since both operands are representable, so they skip from_chars
+    uint32_t mantissa = 0;
+    int digits = 0, exponent = 0;
+
+    for (bool fraction = false; p < end && digits <= 9; ++p)
+    {
+        if (*p >= '0' && *p <= '9')
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            exponent -= fraction;
+            ++digits;
+        }
+        else if (*p == '.' && !fraction)
+        {
+            fraction = true;
+        }
+        else
         {
-            printf("Model parsing failed\n");
             break;
         }
+    }
+
+    const bool exact = digits > 0 && digits <= 9 && mantissa <= (1u << 24) &&
+        exponent >= -10 && (p == end || (*p != 'e' && *p != 'E' && *p != '.'));
+
+    if (exact)
+    {
+        v = (float)mantissa / powersOf10[-exponent];
+        v = negative ? -v : v;
 
-        std::getline(file, s);
+        return true;
     }
 
-    file.close();
+    p = start;
 
-    adjustIndices();
+    // from_chars takes no plus sign
+    if (p < end && *p == '+')
+    {
+        ++p;
+    }
 
-    centerModel();
+    const std::from_chars_result res = std::from_chars(p, end, v);
 
-    calcTangents();
+    p = res.ptr;
 
-    printf("Loaded model. Vertices: %d, faces: %d\n", vCount, fCount);
-    printf("Texture coords: %d, normals: %d\n", tCount, nCount);
+    return res.ec == std::errc();
 }
 
-void Model::getVertices(const Face f, Vertex& a, Vertex& b, Vertex& c)
+bool Model::parseInt(const char*& p, const char* end, int& v)
 {
-    const int vInd0 = f.vertices[0],
-        vInd1 = f.vertices[1],
-        vInd2 = f.vertices[2];
+    skipSpaces(p, end);
 
-    a.v = vertices[vInd0];
-    b.v = vertices[vInd1];
-    c.v = vertices[vInd2];
+    if (p < end && *p == '+')
+    {
+        ++p;
+    }
 
-    a.n = normals[f.normals[0]];
-    b.n = normals[f.normals[1]];
-    c.n = normals[f.normals[2]];
+    const std::from_chars_result res = std::from_chars(p, end, v);
 
-    a.t = uvs[f.uvs[0]];
-    b.t = uvs[f.uvs[1]];
-    c.t = uvs[f.uvs[2]];
+    p = res.ptr;
 
-    a.tangent = tangents[vInd0];
-    b.tangent = tangents[vInd1];
-    c.tangent = tangents[vInd2];
+    return res.ec == std::errc();
 }
 
-void Model::adjustIndices()
+void Model::skipSpaces(const char*& p, const char* end)
 {
-    const int szV = vertices.size(),
-        szN = normals.size();
+    while (p < end && isSpace(*p))
+    {
+        ++p;
+    }
+}
+
+bool Model::isSpace(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+std::string_view Model::lineKeyword(const char*& p, const char* lineEnd)
+{
+    skipSpaces(p, lineEnd);
+
+    const char *token = p;
 
-    for (Face& f : faces)
+    while (p < lineEnd && !isSpace(*p))
     {
-        for (int i = 0; i < 3; ++i)
-        {
-            glm::ivec3& p = f.vertices;
-            p[i] = p[i] > 0 ? p[i] - 1 : szV + p[i];
+        ++p;
+    }
+
+    return std::string_view(token, p - token);
+}
 
-            glm::ivec3& n = f.normals;
-            n[i] = n[i] > 0 ? n[i] - 1 : szN + n[i];
+const char* Model::lineEndOf(const char* p, const char* end)
+{
+    const char *lineEnd = (const char*)memchr(p, '\n', end - p);
+
+    return lineEnd == nullptr ? end : lineEnd;
+}
 
-            glm::ivec3& t = f.uvs;
-            t[i] = t[i] > 0 ? t[i] - 1 : szN + t[i];
+void Model::centerModel(ThreadPool& pool)
+{
+    const int count = vertices.size(),
+        jobs = (count + batchSize - 1) / batchSize;
+
+    // partial sums per batch, added up in batch order
+    std::vector<glm::vec3> sums(jobs);
+
+    pool.Run(jobs, [this, &sums, count](int job)
+    {
+        const int end = std::min((job + 1) * batchSize, count);
+
+        glm::vec3 sum(0.0f);
+
+        for (int i = job * batchSize; i < end; ++i)
+        {
+            sum += vertices[i];
         }
+
+        sums[job] = sum;
+    });
+
+    glm::vec3 center(0.0f);
+
+    for (const glm::vec3 sum : sums)
+    {
+        center += sum;
     }
+
+    center /= (float)count;
+
+    pool.Run(jobs, [this, center, count](int job)
+    {
+        const int end = std::min((job + 1) * batchSize, count);
+
+        for (int i = job * batchSize; i < end; ++i)
+        {
+            vertices[i] -= center;
+        }
+    });
 }
 
-void Model::loadVertex(std::ifstream& file)
+void Model::calcTangents(ThreadPool& pool)
 {
-    glm::vec3 v;
-    float tmp;
+    const int faceCount = faces.size(),
+        vertexCount = vertices.size();
 
-    file >> v.x >> v.y >> v.z;
+    std::vector<glm::vec3> faceTangents(faceCount);
 
-    if (file.peek() == ' ')
+    pool.Run((faceCount + batchSize - 1) / batchSize, [this, &faceTangents, faceCount](int job)
     {
-        // w
-        file >> tmp;
+        const int end = std::min((job + 1) * batchSize, faceCount);
+
+        for (int i = job * batchSize; i < end; ++i)
+        {
+            const int vInd0 = faces[i].vertices[0],
+                vInd1 = faces[i].vertices[1],
+                vInd2 = faces[i].vertices[2];
+
+            const glm::vec3 v0 = vertices[vInd0],
+                v1 = vertices[vInd1],
+                v2 = vertices[vInd2];
+
+            const glm::vec2 uv0 = uvs[vInd0],
+                uv1 = uvs[vInd1],
+                uv2 = uvs[vInd2];
+
+            const glm::vec3 edge1 = v1 - v0,
+                edge2 = v2 - v0;
+
+            const float deltaU1 = uv1.x - uv0.x,
+                deltaV1 = uv1.y - uv0.y,
+                deltaU2 = uv2.x - uv0.x,
+                deltaV2 = uv2.y - uv0.y;
+
+            const float f = 1.0f / (deltaU1 * deltaV2 - deltaU2 * deltaV1);
+
+            glm::vec3& tangent = faceTangents[i];
+
+            tangent.x = f * (deltaV2 * edge1.x - deltaV1 * edge2.x);
+            tangent.y = f * (deltaV2 * edge1.y - deltaV1 * edge2.y);
+            tangent.z = f * (deltaV2 * edge1.z - deltaV1 * edge2.z);
+        }
+    });
+
+    // each vertex gathers its faces' tangents instead of the faces scattering
+    // into shared vertices, in face order as a sequential pass would add them
+    std::vector<int> firstAdjacent, adjacent;
+
+    vertexFaces(firstAdjacent, adjacent);
+
+    tangents.resize(vertexCount);
+
+    pool.Run((vertexCount + batchSize - 1) / batchSize,
+             [this, &faceTangents, &firstAdjacent, &adjacent, vertexCount](int job)
+    {
+        const int end = std::min((job + 1) * batchSize, vertexCount);
+
+        for (int v = job * batchSize; v < end; ++v)
+        {
+            glm::vec3 tangent(0.0f);
+
+            for (int j = firstAdjacent[v]; j < firstAdjacent[v + 1]; ++j)
+            {
+                tangent += faceTangents[adjacent[j]];
+            }
+
+            tangents[v] = glm::normalize(tangent);
+        }
+    });
+}
+
+void Model::buildClusters(const bool optimize)
+{
+    using glm::vec3;
+
+    clusters.clear();
+
+    const int faceCount = faces.size();
+
+    std::vector<vec3> faceNormals(faceCount), centroids(faceCount);
+    vec3 lo(FLT_MAX), hi(-FLT_MAX);
+
+    for (int i = 0; i < faceCount; ++i)
+    {
+        const glm::ivec3 v = faces[i].vertices;
+        const vec3 a = vertices[v[0]],
+            b = vertices[v[1]],
+            c = vertices[v[2]];
+
+        faceNormals[i] = faceNormal(faces[i]);
+        centroids[i] = (a + b + c) / 3.0f;
+
+        lo = glm::min(lo, centroids[i]);
+        hi = glm::max(hi, centroids[i]);
     }
 
-    vertices.push_back(v);
+    const std::vector<int> order = partitionFaces(faceNormals, centroids, lo, hi);
+
+    std::vector<Face> sortedFaces;
+
+    sortedFaces.reserve(faceCount);
+
+    for (const int i : order)
+    {
+        sortedFaces.push_back(faces[i]);
+    }
+
+    faces.swap(sortedFaces);
+
+    for (Cluster& cl : clusters)
+    {
+        calcClusterBounds(cl);
+    }
+
+    if (optimize)
+    {
+        sortClusters();
+
+        std::vector<int> localIndex(vertices.size(), -1);
+
+        for (const Cluster& cl : clusters)
+        {
+            reorderFaces(cl, localIndex);
+        }
+    }
+
+    // number vertices by first use, so each cluster owns a contiguous range
+    const int clusterCount = clusters.size();
+
+    std::vector<int> vertexMap(vertices.size(), -1), vertexOwner;
+    int vertexCount = 0;
+
+    for (int id = 0; id < clusterCount; ++id)
+    {
+        Cluster& cl = clusters[id];
+
+        cl.vertexBegin = vertexCount;
+
+        for (int i = cl.firstFace; i < cl.firstFace + cl.faceCount; ++i)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                int& v = faces[i].vertices[k];
+
+                if (vertexMap[v] < 0)
+                {
+                    vertexMap[v] = vertexCount++;
+                    vertexOwner.push_back(id);
+                }
+
+                v = vertexMap[v];
+            }
+        }
+
+        cl.vertexEnd = vertexCount;
+    }
+
+    // unreferenced vertices go last, outside every cluster
+    for (int& v : vertexMap)
+    {
+        v = v < 0 ? vertexCount++ : v;
+    }
+
+    const std::vector<vec3> oldVertices(vertices), oldNormals(normals), oldTangents(tangents);
+    const std::vector<glm::vec2> oldUVs(uvs);
+
+    for (size_t i = 0; i < vertexMap.size(); ++i)
+    {
+        vertices[vertexMap[i]] = oldVertices[i];
+        normals[vertexMap[i]] = oldNormals[i];
+        uvs[vertexMap[i]] = oldUVs[i];
+        tangents[vertexMap[i]] = oldTangents[i];
+    }
+
+    for (int id = 0; id < clusterCount; ++id)
+    {
+        Cluster& cl = clusters[id];
+
+        for (int i = cl.firstFace; i < cl.firstFace + cl.faceCount; ++i)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                cl.dependencies.push_back(vertexOwner[faces[i].vertices[k]]);
+            }
+        }
+
+        std::vector<int>& deps = cl.dependencies;
+
+        std::sort(deps.begin(), deps.end());
+        deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+        deps.erase(std::remove(deps.begin(), deps.end(), id), deps.end());
+    }
 }
 
-void Model::loadFace(std::ifstream& file)
+std::vector<int> Model::partitionFaces(const std::vector<glm::vec3>& faceNormals,
+                                       const std::vector<glm::vec3>& centroids,
+                                       const glm::vec3 lo, const glm::vec3 hi)
 {
-    glm::ivec3 a, v, t, n;
+    using glm::vec3;
 
-    a = loadFaceVertex(file);
+    const int faceCount = faces.size();
 
-    v[0] = a[0];
-    t[0] = a[1];
-    n[0] = a[2];
+    std::vector<int> firstAdjacent, adjacent;
 
-    a = loadFaceVertex(file);
+    vertexFaces(firstAdjacent, adjacent);
 
-    v[1] = a[0];
-    t[1] = a[1];
-    n[1] = a[2];
+    // clusters start from the first unassigned face along a Morton curve
+    const vec3 invExtent = 1.0f / glm::max(hi - lo, vec3(FLT_MIN));
 
-    a = loadFaceVertex(file);
+    std::vector<uint32_t> keys(faceCount);
+    std::vector<int> seeds(faceCount);
 
-    v[2] = a[0];
-    t[2] = a[1];
-    n[2] = a[2];
+    for (int i = 0; i < faceCount; ++i)
+    {
+        keys[i] = mortonCode((centroids[i] - lo) * invExtent);
+        seeds[i] = i;
+    }
 
-    faces.push_back(Face(v, t, n));
+    std::stable_sort(seeds.begin(), seeds.end(),
+                     [&keys](const int a, const int b) { return keys[a] < keys[b]; });
 
-    bool hasFourthVertex = file.peek() == ' ';
+    std::vector<int> order, candidates;
+    // cluster that last queued each face
+    std::vector<int> queued(faceCount, -1);
+    std::vector<uint8_t> assigned(faceCount, 0);
+    int seed = 0;
 
-    // quad face
-    if (hasFourthVertex)
+    order.reserve(faceCount);
+
+    while ((int)order.size() < faceCount)
     {
-        a = loadFaceVertex(file);
+        const int id = clusters.size();
 
-        v[1] = v[2];
-        t[1] = t[2];
-        n[1] = n[2];
+        Cluster cl = Cluster();
+        cl.firstFace = order.size();
+        cl.faceCount = 0;
 
-        v[2] = a[0];
-        t[2] = a[1];
-        n[2] = a[2];
+        vec3 centroidSum(0.0f), normalSum(0.0f);
 
-        faces.push_back(Face(v, t, n));
+        candidates.clear();
+
+        while (cl.faceCount < maxClusterFaces)
+        {
+            // grow towards the queued face closest to the cluster's centroid,
+            // skipping faces that would widen the cone once the cluster is big enough
+            const vec3 centroid = centroidSum / (float)std::max(cl.faceCount, 1);
+            const float minAlignment = coneSplit * glm::length(normalSum);
+
+            int best = -1;
+            float bestDist = FLT_MAX;
+
+            for (size_t j = 0; j < candidates.size();)
+            {
+                const int f = candidates[j];
+
+                if (assigned[f])
+                {
+                    candidates[j] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+
+                const vec3 d = centroids[f] - centroid;
+                const bool diverging = cl.faceCount >= minClusterFaces &&
+                    faceNormals[f] != vec3(0.0f) &&
+                    glm::dot(faceNormals[f], normalSum) < minAlignment;
+
+                if (!diverging && glm::dot(d, d) < bestDist)
+                {
+                    best = f;
+                    bestDist = glm::dot(d, d);
+                }
+
+                ++j;
+            }
+
+            if (best < 0)
+            {
+                if (cl.faceCount >= minClusterFaces)
+                {
+                    break;
+                }
+
+                // nothing connected is left, continue from a new seed
+                while (seed < faceCount && assigned[seeds[seed]])
+                {
+                    ++seed;
+                }
+
+                if (seed == faceCount)
+                {
+                    break;
+                }
+
+                best = seeds[seed];
+            }
+
+            assigned[best] = 1;
+            order.push_back(best);
+            ++cl.faceCount;
+
+            centroidSum += centroids[best];
+            normalSum += faceNormals[best];
+
+            for (int k = 0; k < 3; ++k)
+            {
+                const int v = faces[best].vertices[k];
+
+                for (int j = firstAdjacent[v]; j < firstAdjacent[v + 1]; ++j)
+                {
+                    const int f = adjacent[j];
+
+                    if (!assigned[f] && queued[f] != id)
+                    {
+                        queued[f] = id;
+                        candidates.push_back(f);
+                    }
+                }
+            }
+        }
+
+        clusters.push_back(cl);
     }
+
+    return order;
 }
 
-glm::ivec3 Model::loadFaceVertex(std::ifstream& file)
+void Model::calcClusterBounds(Cluster& cl)
 {
-    // vertex, texture, normal indices
-    glm::ivec3 v(0);
-    char c;
+    using glm::vec3;
 
-    file >> v[0];
+    const int end = cl.firstFace + cl.faceCount;
 
-    if (file.peek() != '/')
+    vec3 lo(FLT_MAX), hi(-FLT_MAX), normalSum(0.0f);
+
+    for (int i = cl.firstFace; i < end; ++i)
     {
-        return v;
+        for (int k = 0; k < 3; ++k)
+        {
+            lo = glm::min(lo, vertices[faces[i].vertices[k]]);
+            hi = glm::max(hi, vertices[faces[i].vertices[k]]);
+        }
+
+        normalSum += faceNormal(faces[i]);
     }
 
-    file >> c;
+    cl.center = (lo + hi) * 0.5f;
+    cl.radius = 0.0f;
 
-    // normal with no texture
-    if (file.peek() == '/')
+    for (int i = cl.firstFace; i < end; ++i)
     {
-        file >> c >> v[2];
+        for (int k = 0; k < 3; ++k)
+        {
+            cl.radius = std::max(cl.radius, glm::distance(cl.center, vertices[faces[i].vertices[k]]));
+        }
     }
-    else
+
+    const float len = glm::length(normalSum);
+
+    cl.coneAxis = len > 0.0f ? normalSum / len : vec3(0.0f, 0.0f, 1.0f);
+    cl.coneCutoff = len > 0.0f ? 1.0f : -1.0f;
+
+    for (int i = cl.firstFace; i < end; ++i)
     {
-        // texture
-        file >> v[1];
-        if (file.peek() == '/')
+        const vec3 n = faceNormal(faces[i]);
+
+        if (n != vec3(0.0f))
         {
-            // normal
-            file >> c >> v[2];
+            cl.coneCutoff = std::min(cl.coneCutoff, glm::dot(cl.coneAxis, n));
         }
     }
+}
+
+void Model::vertexFaces(std::vector<int>& firstAdjacent, std::vector<int>& adjacent) const
+{
+    const int faceCount = faces.size();
+
+    firstAdjacent.assign(vertices.size() + 1, 0);
+    adjacent.resize(faceCount * 3);
 
-    return v;
+    for (const Face& f : faces)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            ++firstAdjacent[f.vertices[k] + 1];
+        }
+    }
+
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        firstAdjacent[i + 1] += firstAdjacent[i];
+    }
+
+    std::vector<int> next(firstAdjacent.begin(), firstAdjacent.end() - 1);
+
+    for (int i = 0; i < faceCount; ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            adjacent[next[faces[i].vertices[k]]++] = i;
+        }
+    }
 }
 
-void Model::centerModel()
+glm::vec3 Model::faceNormal(const Face f) const
 {
-    glm::vec3 center(0.0f);
+    const glm::vec3 a = vertices[f.vertices[0]],
+        b = vertices[f.vertices[1]],
+        c = vertices[f.vertices[2]];
 
-    for (const glm::vec3 v : vertices)
+    const glm::vec3 n = glm::cross(b - a, c - a);
+    const float len = glm::length(n);
+
+    // degenerate faces cover no pixels, so they do not widen the cone
+    return len > 0.0f ? n / len : glm::vec3(0.0f);
+}
+
+void Model::sortClusters()
+{
+    using glm::vec3;
+
+    vec3 meshCenter(0.0f);
+
+    for (const Cluster& cl : clusters)
     {
-        center += v;
+        meshCenter += cl.center * (float)cl.faceCount;
     }
 
-    center /= (float)vertices.size();
+    meshCenter /= (float)std::max((int)faces.size(), 1);
+
+    // clusters far out along their own normal are likely to occlude the rest,
+    // so they go first
+    std::vector<float> keys(clusters.size());
+    std::vector<int> order(clusters.size());
 
-    for (glm::vec3& v : vertices)
+    for (size_t i = 0; i < clusters.size(); ++i)
     {
-        v -= center;
+        keys[i] = glm::dot(clusters[i].center - meshCenter, clusters[i].coneAxis);
+        order[i] = i;
     }
+
+    std::stable_sort(order.begin(), order.end(),
+                     [&keys](const int a, const int b) { return keys[a] > keys[b]; });
+
+    std::vector<Cluster> sortedClusters;
+    std::vector<Face> sortedFaces;
+
+    sortedClusters.reserve(clusters.size());
+    sortedFaces.reserve(faces.size());
+
+    for (const int id : order)
+    {
+        Cluster cl = clusters[id];
+
+        sortedFaces.insert(sortedFaces.end(), faces.begin() + cl.firstFace,
+                           faces.begin() + cl.firstFace + cl.faceCount);
+
+        cl.firstFace = sortedFaces.size() - cl.faceCount;
+        sortedClusters.push_back(cl);
+    }
+
+    clusters.swap(sortedClusters);
+    faces.swap(sortedFaces);
 }
 
-void Model::calcTangents()
+void Model::reorderFaces(const Cluster& cl, std::vector<int>& localIndex)
 {
-    tangents = std::vector<glm::vec3>(vertices.size(), glm::vec3(0.0f));
+    // Tipsify (Sander et al. 2007) on the cluster's faces, with local vertex ids
+    const Face* const src = faces.data() + cl.firstFace;
+    const int faceCount = cl.faceCount;
 
-    for (const Face fc : faces)
+    std::vector<int> globalIndex;
+    std::vector<glm::ivec3> tris(faceCount);
+
+    for (int t = 0; t < faceCount; ++t)
     {
-        const int vInd0 = fc.vertices[0],
-            vInd1 = fc.vertices[1],
-            vInd2 = fc.vertices[2];
+        for (int k = 0; k < 3; ++k)
+        {
+            int& v = localIndex[src[t].vertices[k]];
 
-        const glm::vec3 v0 = vertices[vInd0],
-            v1 = vertices[vInd1],
-            v2 = vertices[vInd2];
+            if (v < 0)
+            {
+                v = globalIndex.size();
+                globalIndex.push_back(src[t].vertices[k]);
+            }
 
-        const glm::vec2 uv0 = uvs[fc.uvs[0]],
-            uv1 = uvs[fc.uvs[1]],
-            uv2 = uvs[fc.uvs[2]];
+            tris[t][k] = v;
+        }
+    }
 
-        const glm::vec3 edge1 = v1 - v0,
-            edge2 = v2 - v0;
+    const int vertexCount = globalIndex.size();
 
-        const float deltaU1 = uv1.x - uv0.x,
-            deltaV1 = uv1.y - uv0.y,
-            deltaU2 = uv2.x - uv0.x,
-            deltaV2 = uv2.y - uv0.y;
+    // triangles around each vertex
+    std::vector<int> firstAdjacent(vertexCount + 1, 0), adjacent(faceCount * 3);
 
-        const float f = 1.0f / (deltaU1 * deltaV2 - deltaU2 * deltaV1);
+    for (const glm::ivec3 t : tris)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            ++firstAdjacent[t[k] + 1];
+        }
+    }
 
-        glm::vec3 tangent, bitangent;
+    for (int v = 0; v < vertexCount; ++v)
+    {
+        firstAdjacent[v + 1] += firstAdjacent[v];
+    }
 
-        tangent.x = f * (deltaV2 * edge1.x - deltaV1 * edge2.x);
-        tangent.y = f * (deltaV2 * edge1.y - deltaV1 * edge2.y);
-        tangent.z = f * (deltaV2 * edge1.z - deltaV1 * edge2.z);
+    std::vector<int> next(firstAdjacent.begin(), firstAdjacent.end() - 1);
 
-        tangents[vInd0] += tangent;
-        tangents[vInd1] += tangent;
-        tangents[vInd2] += tangent;
+    for (int t = 0; t < faceCount; ++t)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            adjacent[next[tris[t][k]]++] = t;
+        }
     }
 
-    for (glm::vec3& tangent : tangents)
+    // live triangles and cache insertion time per vertex
+    std::vector<int> live(vertexCount), cacheTime(vertexCount, 0), deadEnd, candidates, order;
+    std::vector<uint8_t> emitted(faceCount, 0);
+
+    for (int v = 0; v < vertexCount; ++v)
     {
-        tangent = glm::normalize(tangent);
+        live[v] = firstAdjacent[v + 1] - firstAdjacent[v];
     }
+
+    int fan = 0, time = cacheSize + 1, cursor = 1;
+
+    while (fan >= 0)
+    {
+        candidates.clear();
+
+        for (int j = firstAdjacent[fan]; j < firstAdjacent[fan + 1]; ++j)
+        {
+            const int t = adjacent[j];
+
+            if (emitted[t])
+            {
+                continue;
+            }
+
+            emitted[t] = 1;
+            order.push_back(t);
+
+            for (int k = 0; k < 3; ++k)
+            {
+                const int v = tris[t][k];
+
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+
+                if (time - cacheTime[v] > cacheSize)
+                {
+                    cacheTime[v] = time++;
+                }
+            }
+        }
+
+        // the next fan is the freshest candidate that stays in the cache
+        // while its remaining triangles are emitted
+        fan = -1;
+        int bestPriority = -1;
+
+        for (const int v : candidates)
+        {
+            if (live[v] == 0)
+            {
+                continue;
+            }
+
+            const int age = time - cacheTime[v],
+                priority = age + 2 * live[v] <= cacheSize ? age : 0;
+
+            if (priority > bestPriority)
+            {
+                fan = v;
+                bestPriority = priority;
+            }
+        }
+
+        while (fan < 0 && !deadEnd.empty())
+        {
+            const int v = deadEnd.back();
+            deadEnd.pop_back();
+
+            fan = live[v] > 0 ? v : -1;
+        }
+
+        while (fan < 0 && cursor < vertexCount)
+        {
+            fan = live[cursor] > 0 ? cursor : -1;
+            ++cursor;
+        }
+    }
+
+    std::vector<Face> sorted;
+
+    sorted.reserve(faceCount);
+
+    for (const int t : order)
+    {
+        sorted.push_back(src[t]);
+    }
+
+    std::copy(sorted.begin(), sorted.end(), faces.begin() + cl.firstFace);
+
+    for (const int v : globalIndex)
+    {
+        localIndex[v] = -1;
+    }
+}
+
+float Model::calcACMR(const int cacheSize) const
+{
+    // FIFO post-transform cache, a vertex stays for cacheSize misses
+    std::vector<int> cacheTime(vertices.size(), -cacheSize - 1);
+    int misses = 0;
+
+    for (const Face& f : faces)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            const int v = f.vertices[k];
+
+            if (misses - cacheTime[v] > cacheSize)
+            {
+                cacheTime[v] = misses++;
+            }
+        }
+    }
+
+    return faces.empty() ? 0.0f : (float)misses / faces.size();
+}
+
+uint32_t Model::mortonCode(const glm::vec3 p)
+{
+    uint32_t code = 0;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        uint32_t v = std::min(std::max(p[i], 0.0f), 1.0f) * 1023.0f;
+
+        // spread the 10 bits to every third position
+        v = (v | (v << 16)) & 0x030000FF;
+        v = (v | (v << 8)) & 0x0300F00F;
+        v = (v | (v << 4)) & 0x030C30C3;
+        v = (v | (v << 2)) & 0x09249249;
+
+        code |= v << i;
+    }
+
+    return code;
 }
 
-void Model::loadTextureCoords(std::ifstream& file)
+bool Model::loadTextureCoords(const char*& p, const char* end, ObjChunk& chunk)
 {
     glm::vec2 t;
 
-    file >> t.x >> t.y;
+    if (!parseFloat(p, end, t.x) || !parseFloat(p, end, t.y))
+    {
+        return false;
+    }
 
     t.y = 1.0f - t.y;
 
-    uvs.push_back(t);
+    uvs[chunk.uvs++] = t;
+    return true;
 }
 
-void Model::loadNormal(std::ifstream& file)
+bool Model::loadNormal(const char*& p, const char* end, ObjChunk& chunk)
 {
     glm::vec3 n;
 
-    file >> n.x >> n.y >> n.z;
+    if (!parseFloat(p, end, n.x) || !parseFloat(p, end, n.y) || !parseFloat(p, end, n.z))
+    {
+        return false;
+    }
 
-    normals.push_back(n);
+    normals[chunk.normals++] = n;
+    return true;
 }
@@ -8,6 +8,8 @@ MonoTexture::MonoTexture(const std::string& filename, TextureType type)
     width = 0;
     height = 0;
 
+    std::vector<unsigned char> data;
+
     unsigned error = lodepng::decode(data, width, height, filename, LCT_GREY);
 
     if (!error)
@@ -62,20 +64,33 @@ MonoTexture::MonoTexture(const std::string& filename, TextureType type)
     }
 
     printf("width: %d height: %d\n\n", width, height);
+
+    texels.resize(mips.Init(width, height));
+
+    mips.Fill(texels, [&data](size_t i) { return data[i]; });
+
+    mips.Build(texels, [](unsigned a, unsigned b, unsigned c, unsigned d)
+    {
+        return static_cast<unsigned char>((a + b + c + d + 2) / 4);
+    });
 }
 
 float MonoTexture::getVal(float x, float y)
 {
-    using glm::vec2;
-    using glm::clamp;
-
-    x = std::clamp(x, 0.0f, 1.0f);
-    y = std::clamp(y, 0.0f, 1.0f);
+    return mips.SampleNearest<float>(x, y, [this](size_t i) { return texels[i] / 255.0f; });
+}
 
-    const int newX = round(x * (width - 1)),
-        newY = round(y * (height - 1));
+float MonoTexture::getVal(float x, float y, float lod)
+{
+    return mips.SampleTrilinear<float>(x, y, lod, [this](size_t i) { return texels[i] / 255.0f; });
+}
 
-    const int ind = newY * width + newX;
+unsigned MonoTexture::getWidth() const
+{
+    return width;
+}
 
-    return data[ind] / 255.0f;
+unsigned MonoTexture::getHeight() const
+{
+    return height;
 }
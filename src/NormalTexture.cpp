@@ -1,12 +1,14 @@
 #include "NormalTexture.hpp"
+#include "Utils.hpp"
 
 #include "lodepng.h"
 #include <algorithm>
 
-NormalTexture::NormalTexture(const std::string& filename)
+NormalTexture::NormalTexture(const std::string& filename, ThreadPool& pool)
 {
     width = 0;
     height = 0;
+    defaultMap = false;
 
     std::vector<unsigned char> data;
 
@@ -23,32 +25,64 @@ NormalTexture::NormalTexture(const std::string& filename)
         width = 1;
         height = 1;
 
-        data.resize(3);
-        data[0] = 0;
-        data[1] = 0;
-        data[2] = 255;
+        defaultMap = true;
     }
 
     printf("width: %d height: %d\n\n", width, height);
 
-    for (std::size_t i = 0; i < data.size(); i += 3)
+    normals.resize(mips.Init(width, height));
+
+    if (defaultMap)
     {
-        glm::vec3 n(data[i], data[i + 1], data[i + 2]);
-        n = glm::normalize(n * 2.0f / 255.0f - 1.0f);
+        // unperturbed tangent space normal
+        normals[0] = Utils::PackNormal(glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+    else
+    {
+        mips.Fill(normals, [&data](size_t i)
+        {
+            const glm::vec3 n(data[i * 3], data[i * 3 + 1], data[i * 3 + 2]);
 
-        normals.push_back(n);
+            return Utils::PackNormal(n * 2.0f / 255.0f - 1.0f);
+        }, &pool);
     }
+
+    // renormalized box filter
+    mips.Build(normals, [](glm::u16vec2 a, glm::u16vec2 b, glm::u16vec2 c, glm::u16vec2 d)
+    {
+        const glm::vec3 sum = Utils::UnpackNormal(a) + Utils::UnpackNormal(b) +
+            Utils::UnpackNormal(c) + Utils::UnpackNormal(d);
+
+        return Utils::PackNormal(glm::dot(sum, sum) > 0.0f ? sum : glm::vec3(0.0f, 0.0f, 1.0f));
+    }, &pool);
 }
 
 glm::vec3 NormalTexture::getNormal(float x, float y)
 {
-    x = std::clamp(x, 0.0f, 1.0f);
-    y = std::clamp(y, 0.0f, 1.0f);
+    return mips.SampleNearest<glm::vec3>(x, y, [this](size_t i) { return fetch(i); });
+}
 
-    const int newX = round(x * (width - 1)),
-        newY = round(y * (height - 1));
+glm::vec3 NormalTexture::getNormal(float x, float y, float lod)
+{
+    return mips.SampleTrilinear<glm::vec3>(x, y, lod, [this](size_t i) { return fetch(i); });
+}
 
-    const int ind = newY * width + newX;
+glm::vec3 NormalTexture::fetch(const size_t i) const
+{
+    return Utils::UnpackNormal(normals[i]);
+}
+
+bool NormalTexture::isDefault() const
+{
+    return defaultMap;
+}
 
-    return normals[ind];
+unsigned NormalTexture::getWidth() const
+{
+    return width;
+}
+
+unsigned NormalTexture::getHeight() const
+{
+    return height;
 }
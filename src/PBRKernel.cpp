@@ -0,0 +1,234 @@
+#include "PBRKernel.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+void PBRPacket::Add(const int x, const int y, const float z,
+                    const glm::vec3 n, const glm::vec3 pos, const glm::vec3 albedo,
+                    const float metallic, const float roughness, const float ao,
+                    const glm::vec3 emission)
+{
+    const int i = count++;
+
+    this->x[i] = x;
+    this->y[i] = y;
+    this->z[i] = z;
+
+    nx[i] = n.x;
+    ny[i] = n.y;
+    nz[i] = n.z;
+
+    px[i] = pos.x;
+    py[i] = pos.y;
+    pz[i] = pos.z;
+
+    albedoR[i] = albedo.x;
+    albedoG[i] = albedo.y;
+    albedoB[i] = albedo.z;
+
+    this->metallic[i] = metallic;
+    this->roughness[i] = roughness;
+    this->ao[i] = ao;
+
+    emissionR[i] = emission.x;
+    emissionG[i] = emission.y;
+    emissionB[i] = emission.z;
+}
+
+void PBRKernel::Shade(PBRPacket& p, const glm::vec3 lightVecView)
+{
+    static const bool avx2 = HasAVX2();
+
+    if (avx2)
+    {
+        ShadeAVX2(p, lightVecView);
+    }
+    else
+    {
+        ShadeScalar(p, lightVecView);
+    }
+}
+
+void PBRKernel::ShadeScalar(PBRPacket& p, const glm::vec3 lightVecView)
+{
+    for (int i = 0; i < p.count; ++i)
+    {
+        const glm::vec3 c = ShadeFragment(glm::vec3(p.nx[i], p.ny[i], p.nz[i]),
+                                          glm::vec3(p.px[i], p.py[i], p.pz[i]),
+                                          glm::vec3(p.albedoR[i], p.albedoG[i], p.albedoB[i]),
+                                          p.metallic[i], p.roughness[i], p.ao[i],
+                                          glm::vec3(p.emissionR[i], p.emissionG[i], p.emissionB[i]),
+                                          lightVecView);
+
+        p.r[i] = c.x;
+        p.g[i] = c.y;
+        p.b[i] = c.z;
+    }
+}
+
+bool PBRKernel::HasAVX2()
+{
+#ifdef __x86_64__
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+
+glm::vec3 PBRKernel::ShadeFragment(const glm::vec3 n, const glm::vec3 pos, const glm::vec3 albedo,
+                                   const float metallic, const float roughness,
+                                   const float ao, const glm::vec3 emission,
+                                   const glm::vec3 lightVecView)
+{
+    const glm::vec3 l = -lightVecView,
+        v = glm::normalize(-pos),
+        h = glm::normalize(v + l),
+        F0 = glm::mix(glm::vec3(0.04f), albedo, metallic),
+        F = Utils::FresnelSchlick(std::max(glm::dot(h, v), 0.0f), F0);
+
+    const float NDF = Utils::DistributionGGX(h, n, roughness),
+        G = Utils::GeometrySmith(n, v, l, roughness),
+        NdotL = std::max(glm::dot(n, l), 0.0f);
+
+    const glm::vec3 numerator = NDF * G * F;
+    float denominator = 4.0f * std::max(glm::dot(n, v), 0.0f) * NdotL;
+
+    denominator = std::max(denominator, 0.000001f);
+
+    const glm::vec3 specular = numerator / denominator;
+
+    const glm::vec3& kS = F;
+    const glm::vec3 kD = (1.0f - kS) * (1.0f - metallic),
+        Lo = emission + (kD * albedo / Utils::pi + specular) * NdotL,
+        ambient = glm::vec3(0.03f) * albedo * ao;
+
+    return ambient + Lo;
+}
+
+#ifdef __x86_64__
+
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+
+static inline AVX2_TARGET __m256 dotAVX2(const __m256 ax, const __m256 ay, const __m256 az,
+                                         const __m256 bx, const __m256 by, const __m256 bz)
+{
+    return _mm256_fmadd_ps(ax, bx, _mm256_fmadd_ps(ay, by, _mm256_mul_ps(az, bz)));
+}
+
+static inline AVX2_TARGET void normalizeAVX2(__m256& x, __m256& y, __m256& z)
+{
+    const __m256 len = _mm256_sqrt_ps(dotAVX2(x, y, z, x, y, z));
+
+    x = _mm256_div_ps(x, len);
+    y = _mm256_div_ps(y, len);
+    z = _mm256_div_ps(z, len);
+}
+
+static inline AVX2_TARGET __m256 geometrySchlickGGXAVX2(const __m256 NdotV, const __m256 k)
+{
+    const __m256 denom = _mm256_fmadd_ps(NdotV, _mm256_sub_ps(_mm256_set1_ps(1.0f), k), k);
+
+    return _mm256_div_ps(NdotV, _mm256_max_ps(denom, _mm256_set1_ps(0.000001f)));
+}
+
+AVX2_TARGET void PBRKernel::ShadeAVX2(PBRPacket& p, const glm::vec3 lightVecView)
+{
+    // keep the unused lanes finite
+    for (int i = p.count; i < PBRPacket::size; ++i)
+    {
+        for (float* a : {p.nx, p.ny, p.nz, p.px, p.py, p.pz,
+                         p.albedoR, p.albedoG, p.albedoB,
+                         p.metallic, p.roughness, p.ao,
+                         p.emissionR, p.emissionG, p.emissionB})
+        {
+            a[i] = a[0];
+        }
+    }
+
+    const __m256 zero = _mm256_setzero_ps(),
+        one = _mm256_set1_ps(1.0f),
+        eps = _mm256_set1_ps(0.000001f);
+
+    const __m256 nx = _mm256_load_ps(p.nx), ny = _mm256_load_ps(p.ny), nz = _mm256_load_ps(p.nz),
+        metallic = _mm256_load_ps(p.metallic),
+        roughness = _mm256_load_ps(p.roughness),
+        ao = _mm256_load_ps(p.ao);
+
+    const __m256 albedo[3] = {_mm256_load_ps(p.albedoR),
+                              _mm256_load_ps(p.albedoG),
+                              _mm256_load_ps(p.albedoB)},
+        emission[3] = {_mm256_load_ps(p.emissionR),
+                       _mm256_load_ps(p.emissionG),
+                       _mm256_load_ps(p.emissionB)};
+
+    const __m256 lx = _mm256_set1_ps(-lightVecView.x),
+        ly = _mm256_set1_ps(-lightVecView.y),
+        lz = _mm256_set1_ps(-lightVecView.z);
+
+    __m256 vx = _mm256_sub_ps(zero, _mm256_load_ps(p.px)),
+        vy = _mm256_sub_ps(zero, _mm256_load_ps(p.py)),
+        vz = _mm256_sub_ps(zero, _mm256_load_ps(p.pz));
+
+    normalizeAVX2(vx, vy, vz);
+
+    __m256 hx = _mm256_add_ps(vx, lx),
+        hy = _mm256_add_ps(vy, ly),
+        hz = _mm256_add_ps(vz, lz);
+
+    normalizeAVX2(hx, hy, hz);
+
+    // Fresnel-Schlick with (1 - cos)^5 by multiplication
+    const __m256 cosTheta = _mm256_max_ps(dotAVX2(hx, hy, hz, vx, vy, vz), zero),
+        f1 = _mm256_sub_ps(one, cosTheta),
+        f2 = _mm256_mul_ps(f1, f1),
+        f5 = _mm256_mul_ps(_mm256_mul_ps(f2, f2), f1);
+
+    // GGX normal distribution
+    const __m256 a = _mm256_mul_ps(roughness, roughness),
+        a2 = _mm256_mul_ps(a, a),
+        NdotH = _mm256_max_ps(dotAVX2(nx, ny, nz, hx, hy, hz), zero),
+        d = _mm256_fmadd_ps(_mm256_mul_ps(NdotH, NdotH), _mm256_sub_ps(a2, one), one),
+        ndf = _mm256_div_ps(a2, _mm256_max_ps(_mm256_mul_ps(_mm256_set1_ps(Utils::pi),
+                                                            _mm256_mul_ps(d, d)), eps));
+
+    // Smith geometry term
+    const __m256 r = _mm256_add_ps(roughness, one),
+        k = _mm256_mul_ps(_mm256_mul_ps(r, r), _mm256_set1_ps(1.0f / 8.0f)),
+        NdotV = _mm256_max_ps(dotAVX2(nx, ny, nz, vx, vy, vz), zero),
+        NdotL = _mm256_max_ps(dotAVX2(nx, ny, nz, lx, ly, lz), zero),
+        G = _mm256_mul_ps(geometrySchlickGGXAVX2(NdotV, k), geometrySchlickGGXAVX2(NdotL, k));
+
+    const __m256 denominator = _mm256_max_ps(_mm256_mul_ps(_mm256_set1_ps(4.0f),
+                                                           _mm256_mul_ps(NdotV, NdotL)), eps),
+        specularScale = _mm256_div_ps(_mm256_mul_ps(ndf, G), denominator),
+        diffuseScale = _mm256_mul_ps(_mm256_sub_ps(one, metallic), _mm256_set1_ps(1.0f / Utils::pi)),
+        ambientScale = _mm256_mul_ps(_mm256_set1_ps(0.03f), ao);
+
+    float* out[3] = {p.r, p.g, p.b};
+
+    for (int c = 0; c < 3; ++c)
+    {
+        const __m256 F0 = _mm256_fmadd_ps(_mm256_sub_ps(albedo[c], _mm256_set1_ps(0.04f)),
+                                          metallic, _mm256_set1_ps(0.04f)),
+            F = _mm256_fmadd_ps(_mm256_sub_ps(one, F0), f5, F0),
+            kD = _mm256_sub_ps(one, F),
+            diffuse = _mm256_mul_ps(_mm256_mul_ps(kD, albedo[c]), diffuseScale),
+            Lo = _mm256_fmadd_ps(_mm256_fmadd_ps(F, specularScale, diffuse), NdotL, emission[c]);
+
+        _mm256_store_ps(out[c], _mm256_fmadd_ps(ambientScale, albedo[c], Lo));
+    }
+}
+
+#else
+
+void PBRKernel::ShadeAVX2(PBRPacket& p, const glm::vec3 lightVecView)
+{
+    ShadeScalar(p, lightVecView);
+}
+
+#endif
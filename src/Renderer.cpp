@@ -1,10 +1,15 @@
 #include "Renderer.hpp"
 #include "Utils.hpp"
 #include "TextureType.hpp"
+#include "ResolveKernel.hpp"
 
 #include <cstring>
 #include <cmath>
+#include <cfloat>
 #include <algorithm>
+#include <thread>
+#include <chrono>
+#include <new>
 
 #include <glm/ext.hpp>
 #include <glm/gtx/euler_angles.hpp>
@@ -12,10 +17,16 @@
 Renderer::Renderer()
 {
     buffer = nullptr;
+    hdrBuffer = nullptr;
     zBuffer = nullptr;
+    blockDepth = nullptr;
+    visBuffer = nullptr;
     model = nullptr;
     texDiffuse = nullptr;
     texSpecular = nullptr;
+    material = nullptr;
+    lut = nullptr;
+    pool = nullptr;
 
     ResetParams();
 }
@@ -23,7 +34,16 @@ Renderer::Renderer()
 void Renderer::ResetParams()
 {
     backfaceCulling = true;
+    occlusionCulling = true;
     perspectiveCorrection = true;
+    depthPrepass = false;
+    deferredShading = false;
+    mipmapping = false;
+    colorGrading = true;
+    printStats = false;
+    optimizeModel = true;
+    compressModelCache = false;
+    quantizeVertices = false;
 
     shading = None;
 
@@ -38,6 +58,8 @@ void Renderer::ResetParams()
     lambertFactor = 0.4f;
     spec1 = 20.0f;
     spec2 = 0.5f;
+
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
 }
 
 const void* Renderer::Render(int width, int height, bool sizeChanged)
@@ -55,100 +77,448 @@ const void* Renderer::Render(int width, int height, bool sizeChanged)
 
     if (sizeChanged && buffer != nullptr)
     {
-        char *ptr = (char*)buffer;
-        delete[] ptr;
-        delete[] zBuffer;
+        freeBuffers();
     }
 
     if (sizeChanged || buffer == nullptr)
     {
-        buffer = new uint8_t[width * height * 3];
-        zBuffer = new float[width * height];
+        allocateBuffers();
+        genTiles();
+    }
+
+    updatePool();
+
+    if (shading == PBR && material == nullptr)
+    {
+        material = new MaterialTexture(*texDiffuse, *texNormal, *texMetallic,
+                                       *texRoughness, *texAO, *texEmission, *pool);
     }
 
-    memset((void*)buffer, 0, width * height * 3);
+    memset((void*)hdrBuffer, 0, width * height * 4 * sizeof(float));
 
     for (int i = 0; i < width * height; ++i)
     {
         zBuffer[i] = 1.0f;
     }
 
+    for (int i = 0; i < blocksX * blocksY; ++i)
+    {
+        blockDepth[i] = 1.0f;
+    }
+
+    for (Tile& tile : tiles)
+    {
+        tile.maxDepth = 1.0f;
+        tile.fragments = 0;
+    }
+
     culledFaces = 0;
+    occludedClusters = 0;
+
+    const auto start = std::chrono::steady_clock::now();
 
     renderModel();
 
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    pool->Run(tiles.size(), [this](int i) { resolveTile(tiles[i]); });
+
     if (backfaceCulling)
     {
         printf("Culled faces: %d\n", culledFaces);
     }
 
+    if (printStats && model != nullptr)
+    {
+        printf("Visible clusters: %d/%d\n", (int)visibleClusters.size(),
+               (int)model->clusters.size());
+    }
+
+    if (printStats && occlusionCulling)
+    {
+        printf("Occluded clusters: %d, second pass: %d\n", occludedClusters,
+               (int)secondPassClusters.size());
+    }
+
+    int fragments = 0, coveredPixels = 0;
+
+    for (const Tile& tile : tiles)
+    {
+        fragments += tile.fragments;
+        coveredPixels += tile.coveredPixels;
+    }
+
+    if (printStats)
+    {
+        printf("Shaded fragments: %d, %.2f Mfragments/s\n", fragments,
+               fragments / elapsed.count() / 1e6);
+        printf("Overdraw: %.3f\n", (float)fragments / std::max(coveredPixels, 1));
+    }
+
     return buffer;
 }
 
-void Renderer::drawTriangle(Vertex va, Vertex vb, Vertex vc)
+void Renderer::cullClusters()
 {
-    using std::swap;
+    const std::vector<Cluster>& clusters = model->clusters;
+    const glm::mat4 mv = viewMat * modelMat,
+        rows = glm::transpose(projMat * mv);
 
-    glm::vec4 a = glm::vec4(va.v, 1.0f),
-        b = glm::vec4(vb.v, 1.0f),
-        c = glm::vec4(vc.v, 1.0f);
+    // frustum planes in model space, dot(plane.xyz, p) + plane.w >= 0 inside
+    glm::vec4 planes[6] = {rows[3] + rows[0], rows[3] - rows[0],
+                           rows[3] + rows[1], rows[3] - rows[1],
+                           rows[2], rows[3] - rows[2]};
 
-    glm::vec4 tangA(va.tangent, 0.0f),
-        tangB(vb.tangent, 0.0f),
-        tangC(vc.tangent, 0.0f);
+    for (glm::vec4& plane : planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
 
-    a = modelMat * a;
-    b = modelMat * b;
-    c = modelMat * c;
+    // canCull keeps a face when its view space normal has positive z,
+    // viewDir is that axis in model space with the same sign convention
+    const glm::mat3 m(mv);
+    const glm::vec3 viewDir = glm::normalize(glm::determinant(m) * glm::inverse(m)[2]);
 
-    glm::vec4 na = modelMat * glm::vec4(va.n, 0.0f),
-            nb = modelMat * glm::vec4(vb.n, 0.0f),
-            nc = modelMat * glm::vec4(vc.n, 0.0f);
+    // a new model starts with everything drawn in the first pass
+    if (visibleLastFrame.size() != clusters.size())
+    {
+        visibleLastFrame.assign(clusters.size(), 1);
+    }
 
-    na = glm::normalize(na);
-    nb = glm::normalize(nb);
-    nc = glm::normalize(nc);
+    visibleClusters.clear();
+    firstPassClusters.clear();
+    secondPassClusters.clear();
 
-    tangA = glm::normalize(modelMat * tangA);
-    tangB = glm::normalize(modelMat * tangB);
-    tangC = glm::normalize(modelMat * tangC);
+    for (size_t i = 0; i < clusters.size(); ++i)
+    {
+        if (!clusterInView(clusters[i], planes, viewDir))
+        {
+            visibleLastFrame[i] = 0;
+            continue;
+        }
 
-    a = viewMat * a;
-    b = viewMat * b;
-    c = viewMat * c;
+        visibleClusters.push_back(i);
 
-    na = viewMat * na;
-    nb = viewMat * nb;
-    nc = viewMat * nc;
+        // without occlusion culling every cluster in view is drawn, so turning
+        // it back on starts from a full first pass
+        if (!occlusionCulling)
+        {
+            visibleLastFrame[i] = 1;
+        }
 
-    na = glm::normalize(na);
-    nb = glm::normalize(nb);
-    nc = glm::normalize(nc);
+        if (visibleLastFrame[i])
+        {
+            firstPassClusters.push_back(i);
+        }
+    }
+}
 
-    va.n = na;
-    vb.n = nb;
-    vc.n = nc;
+bool Renderer::clusterInView(const Cluster& cl, const glm::vec4* planes,
+                             const glm::vec3 viewDir) const
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        if (glm::dot(glm::vec3(planes[i]), cl.center) + planes[i].w < -cl.radius)
+        {
+            return false;
+        }
+    }
+
+    if (!backfaceCulling || cl.coneCutoff <= 0.0f)
+    {
+        return true;
+    }
+
+    // culled when every normal in the cone points away from viewDir
+    const float sinCone = std::sqrt(1.0f - cl.coneCutoff * cl.coneCutoff);
+
+    return glm::dot(cl.coneAxis, viewDir) >= -sinCone - coneSlack;
+}
+
+void Renderer::cullOccludedClusters()
+{
+    const glm::mat4 mv = viewMat * modelMat;
+
+    // view space radius of a model space sphere
+    const float radiusScale = std::max(glm::length(glm::vec3(mv[0])),
+                                       std::max(glm::length(glm::vec3(mv[1])),
+                                                glm::length(glm::vec3(mv[2]))));
 
-    va.posView = a;
-    vb.posView = b;
-    vc.posView = c;
+    for (const int id : visibleClusters)
+    {
+        const bool occluded = clusterOccluded(model->clusters[id], mv, radiusScale);
 
-    tangA = glm::normalize(viewMat * tangA);
-    tangB = glm::normalize(viewMat * tangB);
-    tangC = glm::normalize(viewMat * tangC);
+        if (!occluded && !visibleLastFrame[id])
+        {
+            secondPassClusters.push_back(id);
+        }
 
-    va.tangent = tangA;
-    vb.tangent = tangB;
-    vc.tangent = tangC;
+        visibleLastFrame[id] = !occluded;
+        occludedClusters += occluded;
+    }
+}
 
-    a = projMat * a;
-    b = projMat * b;
-    c = projMat * c;
+bool Renderer::clusterOccluded(const Cluster& cl, const glm::mat4& mv,
+                               const float radiusScale) const
+{
+    using glm::vec3;
+    using glm::vec4;
+
+    const vec3 c = mv * vec4(cl.center, 1.0f);
+    const float r = cl.radius * radiusScale,
+        zNearest = c.z + r;
 
-    if (a.z < Renderer::zNear || a.z > Renderer::zFar ||
-        b.z < Renderer::zNear || b.z > Renderer::zFar ||
-        c.z < Renderer::zNear || c.z > Renderer::zFar)
+    // no depth bound for a sphere reaching the near plane
+    if (-zNearest < zNear)
     {
+        return false;
+    }
+
+    // screen rectangle of the sphere's view space bounding box
+    float xMin = FLT_MAX, yMin = FLT_MAX, xMax = -FLT_MAX, yMax = -FLT_MAX;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        const vec3 p = c + vec3(i & 1 ? r : -r, i & 2 ? r : -r, i & 4 ? r : -r);
+        const vec4 clip = projMat * vec4(p, 1.0f);
+        const vec4 screen = viewportMat * (clip / clip.w);
+
+        xMin = std::min(xMin, screen.x);
+        yMin = std::min(yMin, screen.y);
+        xMax = std::max(xMax, screen.x);
+        yMax = std::max(yMax, screen.y);
+    }
+
+    const int x0 = std::max((int)std::floor(xMin), 0),
+        y0 = std::max((int)std::floor(yMin), 0),
+        x1 = std::min((int)std::floor(xMax), width - 1),
+        y1 = std::min((int)std::floor(yMax), height - 1);
+
+    if (x0 > x1 || y0 > y1)
+    {
+        return true;
+    }
+
+    const vec4 nearest = projMat * vec4(0.0f, 0.0f, zNearest, 1.0f);
+
+    return nearest.z / nearest.w - depthEpsilon > maxDepth(x0, y0, x1, y1);
+}
+
+float Renderer::maxDepth(const int x0, const int y0, const int x1, const int y1) const
+{
+    float depth = 0.0f;
+
+    const int bx0 = x0 / blockSize, by0 = y0 / blockSize,
+        bx1 = x1 / blockSize, by1 = y1 / blockSize;
+
+    if ((bx1 - bx0 + 1) * (by1 - by0 + 1) <= maxOcclusionBlocks)
+    {
+        for (int by = by0; by <= by1; ++by)
+        {
+            for (int bx = bx0; bx <= bx1; ++bx)
+            {
+                depth = std::max(depth, blockDepth[by * blocksX + bx]);
+            }
+        }
+
+        return depth;
+    }
+
+    for (int ty = y0 / tileSize; ty <= y1 / tileSize; ++ty)
+    {
+        for (int tx = x0 / tileSize; tx <= x1 / tileSize; ++tx)
+        {
+            depth = std::max(depth, tiles[ty * tilesX + tx].maxDepth);
+        }
+    }
+
+    return depth;
+}
+
+void Renderer::transformVertices(const std::vector<int>& ids)
+{
+    const int count = ids.size(),
+        jobs = (count + clusterBatchSize - 1) / clusterBatchSize;
+
+    pool->Run(jobs, [this, &ids, count](int job)
+    {
+        const int end = std::min((job + 1) * clusterBatchSize, count);
+
+        for (int i = job * clusterBatchSize; i < end; ++i)
+        {
+            const Cluster& cl = model->clusters[ids[i]];
+
+            transformVertices(cl.vertexBegin, cl.vertexEnd);
+        }
+    });
+}
+
+void Renderer::transformVertices(const size_t begin, const size_t end)
+{
+    const glm::mat4 mv = viewMat * modelMat;
+
+    const glm::mat3 tm(mv);
+
+    VertexCache& vc = vertexCache;
+
+    if (model->isQuantized())
+    {
+        // dequantization folded into the model view matrix
+        const glm::vec3 s = model->positionScale,
+            o = model->positionOffset;
+
+        const glm::mat4 dequantize(s.x, 0.0f, 0.0f, 0.0f,
+                                   0.0f, s.y, 0.0f, 0.0f,
+                                   0.0f, 0.0f, s.z, 0.0f,
+                                   o.x, o.y, o.z, 1.0f);
+
+        transformPositions(mv * dequantize, model->packedVertices.data(), begin, end);
+
+        transformDirections(tm, model->packedNormals.data(), vc.normalX.data(),
+                            vc.normalY.data(), vc.normalZ.data(), begin, end);
+
+        transformDirections(tm, model->packedTangents.data(), vc.tangentX.data(),
+                            vc.tangentY.data(), vc.tangentZ.data(), begin, end);
+    }
+    else
+    {
+        transformPositions(mv, model->vertices.data(), begin, end);
+
+        transformDirections(tm, model->normals.data(), vc.normalX.data(), vc.normalY.data(),
+                            vc.normalZ.data(), begin, end);
+
+        transformDirections(tm, model->tangents.data(), vc.tangentX.data(), vc.tangentY.data(),
+                            vc.tangentZ.data(), begin, end);
+    }
+}
+
+template<class T>
+void Renderer::transformPositions(const glm::mat4 mv, const T * __restrict src,
+                                  const size_t begin, const size_t end)
+{
+    const glm::mat4 p = projMat,
+        vp = viewportMat;
+
+    VertexCache& vc = vertexCache;
+
+    float * __restrict viewX = vc.viewX.data(), * __restrict viewY = vc.viewY.data(),
+        * __restrict viewZ = vc.viewZ.data(), * __restrict clipX = vc.clipX.data(),
+        * __restrict clipY = vc.clipY.data(), * __restrict clipZ = vc.clipZ.data(),
+        * __restrict clipW = vc.clipW.data(), * __restrict screenX = vc.screenX.data(),
+        * __restrict screenY = vc.screenY.data(), * __restrict screenZ = vc.screenZ.data();
+
+    for (size_t i = begin; i < end; ++i)
+    {
+        const float x = src[i].x, y = src[i].y, z = src[i].z;
+
+        const float vx = mv[0][0] * x + mv[1][0] * y + mv[2][0] * z + mv[3][0],
+            vy = mv[0][1] * x + mv[1][1] * y + mv[2][1] * z + mv[3][1],
+            vz = mv[0][2] * x + mv[1][2] * y + mv[2][2] * z + mv[3][2];
+
+        const float cx = p[0][0] * vx + p[1][0] * vy + p[2][0] * vz + p[3][0],
+            cy = p[0][1] * vx + p[1][1] * vy + p[2][1] * vz + p[3][1],
+            cz = p[0][2] * vx + p[1][2] * vy + p[2][2] * vz + p[3][2],
+            cw = p[0][3] * vx + p[1][3] * vy + p[2][3] * vz + p[3][3];
+
+        // only used by triangles that pass the depth range test, so a
+        // vertex at w = 0 produces values that are never read
+        const float nx = cx / cw, ny = cy / cw, nz = cz / cw;
+
+        viewX[i] = vx;
+        viewY[i] = vy;
+        viewZ[i] = vz;
+
+        clipX[i] = cx;
+        clipY[i] = cy;
+        clipZ[i] = cz;
+        clipW[i] = cw;
+
+        screenX[i] = vp[0][0] * nx + vp[1][0] * ny + vp[2][0] * nz + vp[3][0];
+        screenY[i] = vp[0][1] * nx + vp[1][1] * ny + vp[2][1] * nz + vp[3][1];
+        screenZ[i] = vp[0][2] * nx + vp[1][2] * ny + vp[2][2] * nz + vp[3][2];
+    }
+}
+
+static inline glm::vec3 direction(const glm::vec3 d)
+{
+    return d;
+}
+
+// octahedral decode without the normalization, which the transform redoes
+static inline glm::vec3 direction(const glm::u16vec2 e)
+{
+    const float ex = e.x * (2.0f / 65535.0f) - 1.0f,
+        ey = e.y * (2.0f / 65535.0f) - 1.0f;
+
+    glm::vec3 d(ex, ey, 1.0f - std::abs(ex) - std::abs(ey));
+
+    const float t = std::max(-d.z, 0.0f);
+
+    d.x += d.x >= 0.0f ? -t : t;
+    d.y += d.y >= 0.0f ? -t : t;
+
+    return d;
+}
+
+template<class T>
+void Renderer::transformDirections(const glm::mat3 m, const T * __restrict src,
+                                   float * __restrict dstX, float * __restrict dstY,
+                                   float * __restrict dstZ,
+                                   const size_t begin, const size_t end)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        const glm::vec3 d = direction(src[i]);
+        const float x = d.x, y = d.y, z = d.z;
+
+        const float dx = m[0][0] * x + m[1][0] * y + m[2][0] * z,
+            dy = m[0][1] * x + m[1][1] * y + m[2][1] * z,
+            dz = m[0][2] * x + m[1][2] * y + m[2][2] * z;
+
+        const float invLen = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz);
+
+        dstX[i] = dx * invLen;
+        dstY[i] = dy * invLen;
+        dstZ[i] = dz * invLen;
+    }
+}
+
+Vertex Renderer::fetchVertex(const Face& f, const int i) const
+{
+    const VertexCache& vc = vertexCache;
+    const int v = f.vertices[i];
+
+    Vertex res;
+
+    res.v = glm::vec3(vc.screenX[v], vc.screenY[v], vc.screenZ[v]);
+    res.posView = glm::vec3(vc.viewX[v], vc.viewY[v], vc.viewZ[v]);
+    res.n = glm::vec3(vc.normalX[v], vc.normalY[v], vc.normalZ[v]);
+    res.tangent = glm::vec3(vc.tangentX[v], vc.tangentY[v], vc.tangentZ[v]);
+    res.t = model->isQuantized() ? glm::unpackHalf2x16(model->packedUVs[v]) : model->uvs[v];
+
+    return res;
+}
+
+glm::vec4 Renderer::clipPosition(const int v) const
+{
+    const VertexCache& vc = vertexCache;
+
+    return glm::vec4(vc.clipX[v], vc.clipY[v], vc.clipZ[v], vc.clipW[v]);
+}
+
+void Renderer::setupTriangle(const Face& f)
+{
+    const glm::vec4 a = clipPosition(f.vertices[0]),
+        b = clipPosition(f.vertices[1]),
+        c = clipPosition(f.vertices[2]);
+
+    const int outA = outCode(a),
+        outB = outCode(b),
+        outC = outCode(c);
+
+    if ((outA & outB & outC) != 0)
+    {
+        // all three vertices are outside the same plane
         return;
     }
 
@@ -158,392 +528,866 @@ void Renderer::drawTriangle(Vertex va, Vertex vb, Vertex vc)
         return;
     }
 
-    a /= a.w;
-    b /= b.w;
-    c /= c.w;
+    const Vertex va = fetchVertex(f, 0),
+        vb = fetchVertex(f, 1),
+        vc = fetchVertex(f, 2);
+
+    if ((outA | outB | outC) == 0)
+    {
+        addTriangle(va, vb, vc);
+        return;
+    }
 
-    a = viewportMat * a;
-    b = viewportMat * b;
-    c = viewportMat * c;
+    clipTriangle(a, b, c, va, vb, vc, outA | outB | outC);
+}
 
-    va.v = a;
-    vb.v = b;
-    vc.v = c;
+int Renderer::outCode(const glm::vec4 p) const
+{
+    int code = 0;
 
-    if (va.v.y > vb.v.y)
+    for (int i = 0; i < clipPlaneCount; ++i)
     {
-        swap(va, vb);
+        if (planeDistance(p, i) < 0.0f)
+        {
+            code |= 1 << i;
+        }
     }
 
-    if (vb.v.y > vc.v.y)
+    return code;
+}
+
+float Renderer::planeDistance(const glm::vec4 p, const int plane) const
+{
+    // clip space z runs from 0 at the near plane to w at the far plane,
+    // x and y are bounded by the guard band rather than the viewport
+    switch (plane)
+    {
+    case 0:
+        return p.z;
+
+    case 1:
+        return p.w - p.z;
+
+    case 2:
+        return p.x + guardX * p.w;
+
+    case 3:
+        return guardX * p.w - p.x;
+
+    case 4:
+        return p.y + guardY * p.w;
+
+    default:
+        return guardY * p.w - p.y;
+    }
+}
+
+void Renderer::clipTriangle(const glm::vec4 a, const glm::vec4 b, const glm::vec4 c,
+                            const Vertex va, const Vertex vb, const Vertex vc,
+                            const int planes)
+{
+    // every plane adds at most one vertex to the polygon
+    constexpr int maxVertices = 3 + clipPlaneCount;
+
+    glm::vec4 pos[maxVertices] = {a, b, c}, newPos[maxVertices];
+    Vertex vert[maxVertices] = {va, vb, vc}, newVert[maxVertices];
+    int count = 3;
+
+    for (int plane = 0; plane < clipPlaneCount; ++plane)
+    {
+        if ((planes & (1 << plane)) == 0)
+        {
+            continue;
+        }
+
+        int newCount = 0;
+
+        for (int i = 0; i < count; ++i)
+        {
+            const int j = (i + 1) % count;
+            const float di = planeDistance(pos[i], plane),
+                dj = planeDistance(pos[j], plane);
+
+            if (di >= 0.0f)
+            {
+                newPos[newCount] = pos[i];
+                newVert[newCount] = vert[i];
+                ++newCount;
+            }
+
+            if ((di >= 0.0f) != (dj >= 0.0f))
+            {
+                const float ratio = di / (di - dj);
+
+                newPos[newCount] = pos[i] + (pos[j] - pos[i]) * ratio;
+                newVert[newCount] = Vertex::Combine(vert[i], vert[j], ratio);
+                ++newCount;
+            }
+        }
+
+        if (newCount < 3)
+        {
+            return;
+        }
+
+        std::copy(newPos, newPos + newCount, pos);
+        std::copy(newVert, newVert + newCount, vert);
+        count = newCount;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        vert[i].v = viewportMat * (pos[i] / pos[i].w);
+    }
+
+    for (int i = 1; i + 1 < count; ++i)
+    {
+        addTriangle(vert[0], vert[i], vert[i + 1]);
+    }
+}
+
+void Renderer::addTriangle(Vertex va, Vertex vb, Vertex vc)
+{
+    using std::swap;
+
+    // snap to the subpixel grid so that coverage is exact and shared
+    // edges are rasterized without gaps or double hits
+    glm::i64vec2 fa = snapToGrid(va.v),
+        fb = snapToGrid(vb.v),
+        fc = snapToGrid(vc.v);
+
+    int64_t area = (fb.x - fa.x) * (fc.y - fa.y) - (fb.y - fa.y) * (fc.x - fa.x);
+
+    if (area == 0)
+    {
+        return;
+    }
+
+    if (area < 0)
     {
         swap(vb, vc);
+        swap(fb, fc);
+        area = -area;
     }
 
-    if (va.v.y > vb.v.y)
+    Triangle tr;
+
+    // pixel (x, y) is sampled at its centre, the fill rule is top-left
+    tr.xMin = std::ceil((std::min({fa.x, fb.x, fc.x}) - subpixelScale / 2) / (double)subpixelScale);
+    tr.yMin = std::ceil((std::min({fa.y, fb.y, fc.y}) - subpixelScale / 2) / (double)subpixelScale);
+    tr.xMax = std::floor((std::max({fa.x, fb.x, fc.x}) - subpixelScale / 2) / (double)subpixelScale) + 1;
+    tr.yMax = std::floor((std::max({fa.y, fb.y, fc.y}) - subpixelScale / 2) / (double)subpixelScale) + 1;
+
+    tr.xMin = std::max(tr.xMin, 0);
+    tr.yMin = std::max(tr.yMin, 0);
+    tr.xMax = std::min(tr.xMax, width);
+    tr.yMax = std::min(tr.yMax, height);
+
+    if (tr.xMin >= tr.xMax || tr.yMin >= tr.yMax)
     {
-        swap(va, vb);
+        return;
     }
 
-    if (va.v.y == vb.v.y)
+    tr.edges[0] = setupEdge(fb, fc);
+    tr.edges[1] = setupEdge(fc, fa);
+    tr.edges[2] = setupEdge(fa, fb);
+
+    setupPlanes(tr, 1.0 / area, va, vb, vc);
+
+    // the depth plane only interpolates inside the triangle
+    tr.zMin = std::min({va.v.z, vb.v.z, vc.v.z}) - depthEpsilon;
+
+    triangles.push_back(tr);
+}
+
+void Renderer::setupPlanes(Triangle& tr, const double invArea,
+                           const Vertex& va, const Vertex& vb, const Vertex& vc)
+{
+    float values[3][AttributeCount];
+    const Vertex* verts[3] = {&va, &vb, &vc};
+
+    for (int i = 0; i < 3; ++i)
     {
-        // natural bottom triangle
-        if (va.v.x > vb.v.x)
+        const Vertex& v = *verts[i];
+        float* attr = values[i];
+
+        attr[AttrDepth] = v.v.z;
+
+        for (int j = 0; j < 3; ++j)
         {
-            swap(va, vb);
+            attr[AttrNormal + j] = v.n[j];
+            attr[AttrTangent + j] = v.tangent[j];
+            attr[AttrPosView + j] = v.posView[j];
         }
-        drawBottomTriangle(va, vb, vc);
+
+        attr[AttrInvDepth] = 1.0f / v.posView.z;
+        attr[AttrUVOverDepth] = v.t.x / v.posView.z;
+        attr[AttrUVOverDepth + 1] = v.t.y / v.posView.z;
+        attr[AttrUV] = v.t.x;
+        attr[AttrUV + 1] = v.t.y;
     }
-    else if (vb.v.y == vc.v.y)
+
+    // the barycentric of vertex i is E_i / area, so the attribute
+    // gradients follow directly from the edge function steps
+    const EdgeFunction* e = tr.edges;
+    double origin[3];
+
+    for (int i = 0; i < 3; ++i)
     {
-        // natural top triangle
-        if (vb.v.x > vc.v.x)
+        origin[i] = e[i].stepX * tr.xMin + e[i].stepY * tr.yMin + e[i].offset;
+    }
+
+    for (int k = 0; k < AttributeCount; ++k)
+    {
+        double base = 0.0, dx = 0.0, dy = 0.0;
+
+        for (int i = 0; i < 3; ++i)
         {
-            swap(vb, vc);
+            base += values[i][k] * origin[i];
+            dx += values[i][k] * (double)e[i].stepX;
+            dy += values[i][k] * (double)e[i].stepY;
         }
-        drawTopTriangle(va, vb, vc);
+
+        tr.base[k] = base * invArea;
+        tr.dx[k] = dx * invArea;
+        tr.dy[k] = dy * invArea;
     }
-    else // general triangle
+}
+
+glm::i64vec2 Renderer::snapToGrid(const glm::vec3 p)
+{
+    return glm::i64vec2(std::llround(p.x * subpixelScale),
+                        std::llround(p.y * subpixelScale));
+}
+
+EdgeFunction Renderer::setupEdge(const glm::i64vec2 p, const glm::i64vec2 q)
+{
+    const int64_t dx = q.x - p.x,
+        dy = q.y - p.y,
+        half = subpixelScale / 2;
+
+    EdgeFunction e;
+
+    e.stepX = -dy * subpixelScale;
+    e.stepY = dx * subpixelScale;
+    e.offset = dx * (half - p.y) - dy * (half - p.x);
+
+    // pixels exactly on an edge belong to the triangle only
+    // if it is a top or a left edge
+    const bool topLeft = dy < 0 || (dy == 0 && dx > 0);
+    e.threshold = topLeft ? 0 : 1;
+
+    return e;
+}
+
+template<class V, RasterPass Pass>
+int Renderer::drawTriangle(const int id, Tile& tile)
+{
+    const Triangle& tr = triangles[id];
+
+    if (occluded<Pass>(tr.zMin, tile.maxDepth))
+    {
+        return 0;
+    }
+
+    const int x0 = std::max(tr.xMin, tile.x0),
+        y0 = std::max(tr.yMin, tile.y0),
+        x1 = std::min(tr.xMax, tile.x1),
+        y1 = std::min(tr.yMax, tile.y1);
+
+    if (x0 >= x1 || y0 >= y1)
     {
-        const float ratio = (vb.v.y - va.v.y) / (vc.v.y - va.v.y);
-        const float newX = (1.0f - ratio) * va.v.x + ratio * vc.v.x;
+        return 0;
+    }
+
+    int shaded = 0;
+    bool depthChanged = false;
 
-        if (vb.v.x < newX)
+    // PBR fragments are shaded in packets, flushed before the next triangle
+    PBRPacket packet;
+    packet.count = 0;
+
+    // tiles are block aligned, so the blocks never leave the tile
+    for (int by = y0 & ~(blockSize - 1); by < y1; by += blockSize)
+    {
+        for (int bx = x0 & ~(blockSize - 1); bx < x1; bx += blockSize)
         {
-            // left triangle
-            drawLeftTriangle(va, vb, vc);
+            // coarse rejection against the farthest depth already in the block
+            if (occluded<Pass>(blockMinDepth(tr, bx, by), blockDepth[blockIndex(bx, by)]))
+            {
+                continue;
+            }
+
+            uint64_t mask = coverBlock(tr, bx, by);
+
+            if (mask != 0)
+            {
+                mask &= blockRectMask(bx, by, x0, y0, x1, y1);
+            }
+
+            if (mask == 0)
+            {
+                continue;
+            }
+
+            const int passed = drawBlock<V, Pass>(id, bx, by, mask, packet);
+
+            // the shading pass only reads depth
+            if (Pass != ShadingPass && passed > 0)
+            {
+                updateBlockDepth(bx, by);
+                depthChanged = true;
+            }
+
+            shaded += passed;
         }
-        else
+    }
+
+    if constexpr (V::shading == PBR)
+    {
+        flushPacket(packet);
+    }
+
+    if (depthChanged)
+    {
+        updateTileDepth(tile);
+    }
+
+    return shaded;
+}
+
+// with every fragment at zMin or farther, nothing can pass the depth test
+template<RasterPass Pass>
+bool Renderer::occluded(const float zMin, const float maxDepth)
+{
+    if constexpr (Pass == ShadingPass)
+    {
+        return zMin > maxDepth;
+    }
+
+    return zMin >= maxDepth;
+}
+
+float Renderer::blockMinDepth(const Triangle& tr, const int bx, const int by)
+{
+    const float dzdx = tr.dx[AttrDepth],
+        dzdy = tr.dy[AttrDepth];
+
+    // the plane is smallest at one of the block corners
+    const float z = tr.base[AttrDepth] + dzdx * (bx - tr.xMin) + dzdy * (by - tr.yMin) +
+        std::min(dzdx, 0.0f) * (blockSize - 1) + std::min(dzdy, 0.0f) * (blockSize - 1);
+
+    return std::max(z - depthEpsilon, tr.zMin);
+}
+
+void Renderer::updateBlockDepth(const int bx, const int by)
+{
+    const int x1 = std::min(bx + blockSize, width),
+        y1 = std::min(by + blockSize, height);
+
+    float maxDepth = 0.0f;
+
+    for (int y = by; y < y1; ++y)
+    {
+        const float *row = zBuffer + index(y, 0);
+
+        for (int x = bx; x < x1; ++x)
         {
-            // right triangle
-            drawRightTriangle(va, vb, vc);
+            maxDepth = std::max(maxDepth, row[x]);
         }
     }
+
+    blockDepth[blockIndex(bx, by)] = maxDepth;
 }
 
-void Renderer::drawLeftTriangle(Vertex va, Vertex vb, Vertex vc)
+void Renderer::updateTileDepth(Tile& tile)
 {
-    const glm::vec3& a = va.v,
-        b = vb.v,
-        c = vc.v;
+    const int bx1 = (tile.x1 + blockSize - 1) / blockSize,
+        by1 = (tile.y1 + blockSize - 1) / blockSize;
 
-    float mLeft = (b.x - a.x) / (b.y - a.y),
-        mRight = (c.x - a.x) / (c.y - a.y);
+    float maxDepth = 0.0f;
 
-    glm::vec3 brLeft(1.0f, 0.0f, 0.0f),
-        brRight(1.0f, 0.0f, 0.0f);
+    for (int by = tile.y0 / blockSize; by < by1; ++by)
+    {
+        for (int bx = tile.x0 / blockSize; bx < bx1; ++bx)
+        {
+            maxDepth = std::max(maxDepth, blockDepth[by * blocksX + bx]);
+        }
+    }
 
-    glm::vec3 brStepLeft = glm::vec3(-1.0f, 1.0f, 0.0f) / (b.y - a.y);
-    const glm::vec3 brStepRight = glm::vec3(-1.0f, 0.0f, 1.0f) / (c.y - a.y);
+    tile.maxDepth = maxDepth;
+}
 
-    int yStart = std::ceil(a.y - 0.5f),
-        yEnd = std::ceil(b.y - 0.5f);
+uint64_t Renderer::coverBlock(const Triangle& tr, const int bx, const int by)
+{
+    bool full = true;
 
-    brLeft += brStepLeft * (yStart - a.y + 0.5f);
-    brRight += brStepRight * (yStart - a.y + 0.5f);
+    for (const EdgeFunction& e : tr.edges)
+    {
+        const int64_t corner = e.stepX * bx + e.stepY * by + e.offset,
+            dx = e.stepX * (blockSize - 1),
+            dy = e.stepY * (blockSize - 1),
+            lo = corner + std::min<int64_t>(dx, 0) + std::min<int64_t>(dy, 0),
+            hi = corner + std::max<int64_t>(dx, 0) + std::max<int64_t>(dy, 0);
+
+        if (hi < e.threshold)
+        {
+            // the whole block is outside this edge
+            return 0;
+        }
+
+        if (lo < e.threshold)
+        {
+            full = false;
+        }
+    }
 
-    for (int y = yStart; y < yEnd; ++y)
+    if (full)
     {
-        const float pxLeft = mLeft * (y - a.y + 0.5f) + a.x,
-            pxRight = mRight * (y - a.y + 0.5f) + a.x;
+        return ~(uint64_t)0;
+    }
+
+    const EdgeFunction &e0 = tr.edges[0],
+        &e1 = tr.edges[1],
+        &e2 = tr.edges[2];
 
-        const int xStart = std::ceil(pxLeft - 0.5f),
-            xEnd = std::ceil(pxRight - 0.5f);
+    int64_t row0 = e0.stepX * bx + e0.stepY * by + e0.offset - e0.threshold,
+        row1 = e1.stepX * bx + e1.stepY * by + e1.offset - e1.threshold,
+        row2 = e2.stepX * bx + e2.stepY * by + e2.offset - e2.threshold;
 
-        const glm::vec3 brScanStep = (brRight - brLeft) / (pxRight - pxLeft);
+    uint64_t mask = 0;
 
-        glm::vec3 br = brLeft + brScanStep * (xStart - pxLeft + 0.5f);
+    for (int i = 0; i < blockSize; ++i)
+    {
+        int64_t w0 = row0, w1 = row1, w2 = row2;
 
-        for (int x = xStart; x < xEnd; ++x)
+        for (int j = 0; j < blockSize; ++j)
         {
-            drawFragment(br, x, y, va, vb, vc);
+            const uint64_t inside = (w0 | w1 | w2) >= 0;
+            mask |= inside << (i * blockSize + j);
 
-            br += brScanStep;
+            w0 += e0.stepX;
+            w1 += e1.stepX;
+            w2 += e2.stepX;
         }
 
-        brLeft += brStepLeft;
-        brRight += brStepRight;
+        row0 += e0.stepY;
+        row1 += e1.stepY;
+        row2 += e2.stepY;
     }
 
-    brLeft = glm::vec3(0.0f, 1.0f, 0.0f);
+    return mask;
+}
+
+uint64_t Renderer::blockRectMask(const int bx, const int by,
+                                 const int x0, const int y0,
+                                 const int x1, const int y1)
+{
+    const int colStart = std::max(x0 - bx, 0),
+        colEnd = std::min(x1 - bx, blockSize),
+        rowStart = std::max(y0 - by, 0),
+        rowEnd = std::min(y1 - by, blockSize);
+
+    const uint64_t rowMask = ((1u << colEnd) - 1) & ~((1u << colStart) - 1);
+
+    uint64_t mask = 0;
+
+    for (int i = rowStart; i < rowEnd; ++i)
+    {
+        mask |= rowMask << (i * blockSize);
+    }
+
+    return mask;
+}
+
+template<class V, RasterPass Pass>
+int Renderer::drawBlock(const int id, const int bx, const int by, uint64_t mask,
+                        PBRPacket& packet)
+{
+    const Triangle& tr = triangles[id];
 
-    const float rt = (b.y - a.y) / (c.y - a.y);
-    brRight = glm::vec3(1.0f - rt, 0.0f, rt);
+    constexpr bool shades = Pass == ForwardPass || Pass == ShadingPass;
 
-    brStepLeft = glm::vec3(0.0f, -1.0f, 1.0f) / (c.y - b.y);
+    const float dzdx = tr.dx[AttrDepth],
+        dzdy = tr.dy[AttrDepth],
+        zBlock = tr.base[AttrDepth] + dzdx * (bx - tr.xMin) + dzdy * (by - tr.yMin);
 
-    yStart = yEnd;
-    yEnd = std::ceil(c.y - 0.5f);
+    // the kernel's attributes at the start of the current row, stepped by adds
+    float rowAttr[AttributeCount], attr[AttributeCount];
 
-    mLeft = (c.x - b.x) / (c.y - b.y);
+    if constexpr (shades)
+    {
+        evalAttributes<V>(tr, bx, by, rowAttr);
+    }
 
-    brLeft += brStepLeft * (yStart - b.y + 0.5f);
-    brRight += brStepRight * (yStart - b.y + 0.5f);
+    int shaded = 0;
 
-    for (int y = yStart; y < yEnd; ++y)
+    for (int i = 0; i < blockSize && mask != 0; ++i)
     {
-        const float pxLeft = mLeft * (y - b.y + 0.5f) + b.x,
-            pxRight = mRight * (y - a.y + 0.5f) + a.x;
+        uint64_t rowMask = mask & rowBits;
+        mask >>= blockSize;
 
-        const int xStart = std::ceil(pxLeft - 0.5f),
-            xEnd = std::ceil(pxRight - 0.5f);
+        if constexpr (shades)
+        {
+            if (i > 0)
+            {
+                stepAttributes<V>(tr.dy, rowAttr);
+            }
+
+            if (rowMask != 0)
+            {
+                copyAttributes<V>(rowAttr, attr);
+            }
+        }
 
-        const glm::vec3 brScanStep = (brRight - brLeft) / (pxRight - pxLeft);
+        // column attr currently holds
+        int column = 0;
 
-        glm::vec3 br = brLeft + brScanStep * (xStart - pxLeft + 0.5f);
+        while (rowMask != 0)
+        {
+            const int j = __builtin_ctzll(rowMask);
+            rowMask &= rowMask - 1;
+
+            const int x = bx + j,
+                y = by + i;
+
+            const float z = zBlock + dzdx * j + dzdy * i;
+            const int ind = index(y, x);
+            float& depth = zBuffer[ind];
+
+            // resolve visibility before any texture is sampled
+            if (Pass == ShadingPass ? z != depth : z >= depth)
+            {
+                continue;
+            }
+
+            ++shaded;
+
+            if constexpr (Pass == DepthPrepass)
+            {
+                depth = z;
+                continue;
+            }
+
+            if constexpr (Pass == VisibilityPass)
+            {
+                depth = z;
+                visBuffer[ind].triangle = id;
+                continue;
+            }
+
+            // written now so the depth hierarchy sees it before a PBR packet is flushed
+            if constexpr (Pass == ForwardPass)
+            {
+                depth = z;
+            }
+
+            for (; column < j; ++column)
+            {
+                stepAttributes<V>(tr.dx, attr);
+            }
+
+            drawFragment<V>(tr, attr, x, y, z, packet);
+        }
+    }
+
+    return shaded;
+}
+
+template<class V, class Op>
+void Renderer::forEachAttribute(Op op)
+{
+    if constexpr (V::shading != None)
+    {
+        op(AttrNormal, 3);
+        op(AttrPosView, 3);
+
+        if constexpr (V::normalMap)
+        {
+            op(AttrTangent, 3);
+        }
+    }
+
+    // 1 / z and uv / z are adjacent
+    if constexpr (V::perspectiveCorrection)
+    {
+        op(AttrInvDepth, 3);
+    }
+    else
+    {
+        op(AttrUV, 2);
+    }
+}
+
+template<class V>
+void Renderer::evalAttributes(const Triangle& tr, const int x, const int y, float* attr)
+{
+    const float fx = x - tr.xMin,
+        fy = y - tr.yMin;
+
+    forEachAttribute<V>([&](const int first, const int count)
+    {
+        for (int i = first; i < first + count; ++i)
+        {
+            attr[i] = tr.base[i] + tr.dx[i] * fx + tr.dy[i] * fy;
+        }
+    });
+}
 
-        for (int x = xStart; x < xEnd; ++x)
+template<class V>
+void Renderer::stepAttributes(const float* step, float* attr)
+{
+    forEachAttribute<V>([&](const int first, const int count)
+    {
+        for (int i = first; i < first + count; ++i)
         {
-            drawFragment(br, x, y, va, vb, vc);
-
-            br += brScanStep;
+            attr[i] += step[i];
         }
-
-        brLeft += brStepLeft;
-        brRight += brStepRight;
-    }
+    });
 }
 
-void Renderer::drawRightTriangle(Vertex va, Vertex vb, Vertex vc)
+template<class V>
+void Renderer::copyAttributes(const float* src, float* dst)
 {
-    const glm::vec3& a = va.v,
-        b = vb.v,
-        c = vc.v;
+    forEachAttribute<V>([&](const int first, const int count)
+    {
+        for (int i = first; i < first + count; ++i)
+        {
+            dst[i] = src[i];
+        }
+    });
+}
 
-    const float mLeft = (c.x - a.x) / (c.y - a.y);
-    float mRight = (b.x - a.x) / (b.y - a.y);
+template<class V>
+void Renderer::drawFragment(const Triangle& tr, const float* attr, const int x, const int y,
+                            const float z, PBRPacket& packet)
+{
+    glm::vec2 t;
 
-    glm::vec3 brLeft(1.0f, 0.0f, 0.0f),
-        brRight(1.0f, 0.0f, 0.0f);
+    if constexpr (V::perspectiveCorrection)
+    {
+        t = glm::vec2(attr[AttrUVOverDepth], attr[AttrUVOverDepth + 1]) / attr[AttrInvDepth];
+    }
+    else
+    {
+        t = glm::vec2(attr[AttrUV], attr[AttrUV + 1]);
+    }
 
-    const glm::vec3 brStepLeft = glm::vec3(-1.0f, 0.0f, 1.0f) / (c.y - a.y);
-    glm::vec3 brStepRight = glm::vec3(-1.0f, 1.0f, 0.0f) / (b.y - a.y);
+    const float lod = calcLod<V>(tr, attr, t);
 
-    int yStart = std::ceil(a.y - 0.5f),
-        yEnd = std::ceil(b.y - 0.5f);
+    if constexpr (V::shading == None)
+    {
+        setPixel(x, y, z, sampleCol<V>(texDiffuse, t, lod));
+        return;
+    }
 
-    brLeft += brStepLeft * (yStart - a.y + 0.5f);
-    brRight += brStepRight * (yStart - a.y + 0.5f);
+    // the tangent is orthonormalized against n in calcNormal,
+    // so only the normal needs to be unit length here
+    glm::vec3 n = glm::normalize(glm::vec3(attr[AttrNormal], attr[AttrNormal + 1],
+                                           attr[AttrNormal + 2]));
+    const glm::vec3 posView(attr[AttrPosView], attr[AttrPosView + 1], attr[AttrPosView + 2]),
+        tangent(attr[AttrTangent], attr[AttrTangent + 1], attr[AttrTangent + 2]);
 
-    for (int y = yStart; y < yEnd; ++y)
+    if constexpr (V::shading == PBR)
     {
-        const float pxLeft = mLeft * (y - a.y + 0.5f) + a.x,
-            pxRight = mRight * (y - a.y + 0.5f) + a.x;
-
-        const int xStart = std::ceil(pxLeft - 0.5f),
-            xEnd = std::ceil(pxRight - 0.5f);
+        // one fetch from the packed material serves every PBR input
+        const MaterialSample m = sampleMaterial<V>(material, t, lod);
 
-        const glm::vec3 brScanStep = (brRight - brLeft) / (pxRight - pxLeft);
+        if constexpr (V::normalMap)
+        {
+            n = calcNormal(n, tangent, m.normal);
+        }
 
-        glm::vec3 br = brLeft + brScanStep * (xStart - pxLeft + 0.5f);
+        packet.Add(x, y, z, n, posView, m.albedo, m.metallic, m.roughness, m.ao,
+                   V::emissionMap ? m.emission : glm::vec3(0.0f));
 
-        for (int x = xStart; x < xEnd; ++x)
+        if (packet.count == PBRPacket::size)
         {
-            drawFragment(br, x, y, va, vb, vc);
-
-            br += brScanStep;
+            flushPacket(packet);
         }
 
-        brLeft += brStepLeft;
-        brRight += brStepRight;
+        return;
     }
 
-    brRight = glm::vec3(0.0f, 1.0f, 0.0f);
-
-    const float rt = (b.y - a.y) / (c.y - a.y);
-    brLeft = glm::vec3(1.0f - rt, 0.0f, rt);
-
-    brStepRight = glm::vec3(0.0f, -1.0f, 1.0f) / (c.y - b.y);
-
-    yStart = yEnd;
-    yEnd = std::ceil(c.y - 0.5f);
-
-    mRight = (c.x - b.x) / (c.y - b.y);
-
-    brLeft += brStepLeft * (yStart - b.y + 0.5f);
-    brRight += brStepRight * (yStart - b.y + 0.5f);
-
-    for (int y = yStart; y < yEnd; ++y)
+    if constexpr (V::normalMap)
     {
-        const float pxLeft = mLeft * (y - a.y + 0.5f) + a.x,
-            pxRight = mRight * (y - b.y + 0.5f) + b.x;
+        n = calcNormal(n, tangent, sampleNormal<V>(texNormal, t, lod));
+    }
 
-        const int xStart = std::ceil(pxLeft - 0.5f),
-            xEnd = std::ceil(pxRight - 0.5f);
+    const glm::vec3 bps = calcBlinnPhongShading(posView, n);
+    const glm::vec3 cSpec = sampleCol<V>(texSpecular, t, lod) * bps.z;
 
-        const glm::vec3 brScanStep = (brRight - brLeft) / (pxRight - pxLeft);
+    setPixel(x, y, z, sampleCol<V>(texDiffuse, t, lod) * (bps.x + bps.y) + cSpec);
+}
 
-        glm::vec3 br = brLeft + brScanStep * (xStart - pxLeft + 0.5f);
+// uv derivatives come straight from the attribute planes,
+// for perspective correction through the quotient rule
+template<class V>
+float Renderer::calcLod(const Triangle& tr, const float* attr, const glm::vec2 t)
+{
+    if constexpr (!V::mipmapping)
+    {
+        return 0.0f;
+    }
 
-        for (int x = xStart; x < xEnd; ++x)
-        {
-            drawFragment(br, x, y, va, vb, vc);
+    glm::vec2 dtdx, dtdy;
 
-            br += brScanStep;
-        }
+    if constexpr (V::perspectiveCorrection)
+    {
+        const float invDepth = attr[AttrInvDepth];
 
-        brLeft += brStepLeft;
-        brRight += brStepRight;
+        dtdx = (glm::vec2(tr.dx[AttrUVOverDepth], tr.dx[AttrUVOverDepth + 1]) -
+                t * tr.dx[AttrInvDepth]) / invDepth;
+        dtdy = (glm::vec2(tr.dy[AttrUVOverDepth], tr.dy[AttrUVOverDepth + 1]) -
+                t * tr.dy[AttrInvDepth]) / invDepth;
+    }
+    else
+    {
+        dtdx = glm::vec2(tr.dx[AttrUV], tr.dx[AttrUV + 1]);
+        dtdy = glm::vec2(tr.dy[AttrUV], tr.dy[AttrUV + 1]);
     }
+
+    return 0.5f * std::log2(std::max(glm::dot(dtdx, dtdx), glm::dot(dtdy, dtdy)));
 }
 
-void Renderer::drawTopTriangle(Vertex va, Vertex vb, Vertex vc)
+template<class V>
+glm::vec3 Renderer::sampleCol(Texture* tex, const glm::vec2 t, const float lod)
 {
-    const glm::vec3& a = va.v,
-        b = vb.v,
-        c = vc.v;
-
-    const float mLeft = (b.x - a.x) / (c.y - a.y),
-        mRight = (c.x - a.x) / (c.y - a.y);
-
-    glm::vec3 brLeft(1.0f, 0.0f, 0.0f),
-        brRight(1.0f, 0.0f, 0.0f);
+    if constexpr (V::mipmapping)
+    {
+        return tex->getCol(t.x, t.y, lod);
+    }
 
-    const glm::vec3 brStepLeft = glm::vec3(-1.0f, 1.0f, 0.0f) / (c.y - a.y),
-        brStepRight = glm::vec3(-1.0f, 0.0f, 1.0f) / (c.y - a.y);
+    return tex->getCol(t.x, t.y);
+}
 
-    const int yStart = std::ceil(a.y - 0.5f),
-        yEnd = std::ceil(c.y - 0.5f);
+template<class V>
+float Renderer::sampleVal(MonoTexture* tex, const glm::vec2 t, const float lod)
+{
+    if constexpr (V::mipmapping)
+    {
+        return tex->getVal(t.x, t.y, lod);
+    }
 
-    brLeft += brStepLeft * (yStart - a.y + 0.5f);
-    brRight += brStepRight * (yStart - a.y + 0.5f);
+    return tex->getVal(t.x, t.y);
+}
 
-    for (int y = yStart; y < yEnd; ++y)
+template<class V>
+glm::vec3 Renderer::sampleNormal(NormalTexture* tex, const glm::vec2 t, const float lod)
+{
+    if constexpr (V::mipmapping)
     {
-        const float pxLeft = mLeft * (y - a.y + 0.5f) + a.x,
-            pxRight = mRight * (y - a.y + 0.5f) + a.x;
+        return tex->getNormal(t.x, t.y, lod);
+    }
 
-        const int xStart = std::ceil(pxLeft - 0.5f),
-            xEnd = std::ceil(pxRight - 0.5f);
+    return tex->getNormal(t.x, t.y);
+}
 
-        const glm::vec3 brScanStep = (brRight - brLeft) / (pxRight - pxLeft);
+template<class V>
+MaterialSample Renderer::sampleMaterial(MaterialTexture* tex, const glm::vec2 t, const float lod)
+{
+    if constexpr (V::mipmapping)
+    {
+        return tex->getSample(t.x, t.y, lod);
+    }
 
-        glm::vec3 br = brLeft + brScanStep * (xStart - pxLeft + 0.5f);
+    return tex->getSample(t.x, t.y);
+}
 
-        for (int x = xStart; x < xEnd; ++x)
-        {
-            drawFragment(br, x, y, va, vb, vc);
+void Renderer::flushPacket(PBRPacket& packet)
+{
+    if (packet.count == 0)
+    {
+        return;
+    }
 
-            br += brScanStep;
-        }
+    PBRKernel::Shade(packet, lightVecView);
 
-        brLeft += brStepLeft;
-        brRight += brStepRight;
+    for (int i = 0; i < packet.count; ++i)
+    {
+        setPixel(packet.x[i], packet.y[i], packet.z[i],
+                 glm::vec3(packet.r[i], packet.g[i], packet.b[i]));
     }
+
+    packet.count = 0;
 }
 
-void Renderer::drawBottomTriangle(Vertex va, Vertex vb, Vertex vc)
+void Renderer::setPixel(const int x, const int y, const float z, const glm::vec3 c)
 {
-    const glm::vec3& a = va.v,
-        b = vb.v,
-        c = vc.v;
-
-    const float mLeft = (c.x - a.x) / (c.y - a.y),
-        mRight = (c.x - b.x) / (c.y - a.y);
+    const int ind = index(y, x);
 
-    glm::vec3 brLeft(1.0f, 0.0f, 0.0f),
-        brRight(0.0f, 1.0f, 0.0f);
+    zBuffer[ind] = z;
 
-    const glm::vec3 brStepLeft = glm::vec3(-1.0f, 0.0f, 1.0f) / (c.y - a.y),
-        brStepRight = glm::vec3(0.0f, -1.0f, 1.0f) / (c.y - a.y);
+    hdrBuffer[ind * 4] = c.x;
+    hdrBuffer[ind * 4 + 1] = c.y;
+    hdrBuffer[ind * 4 + 2] = c.z;
+}
 
-    const int yStart = std::ceil(a.y - 0.5f),
-        yEnd = std::ceil(c.y - 0.5f);
+void Renderer::resolveTile(Tile& tile)
+{
+    // only PBR produces scene referred colour
+    const bool tonemap = shading == PBR,
+        grade = colorGrading && lut != nullptr && lut->isLoaded();
 
-    brLeft += brStepLeft * (yStart - a.y + 0.5f);
-    brRight += brStepRight * (yStart - a.y + 0.5f);
+    tile.coveredPixels = 0;
 
-    for (int y = yStart; y < yEnd; ++y)
+    for (int y = tile.y0; y < tile.y1; ++y)
     {
-        const float pxLeft = mLeft * (y - a.y + 0.5f) + a.x,
-            pxRight = mRight * (y - a.y + 0.5f) + b.x;
+        const int ind = index(y, tile.x0),
+            count = tile.x1 - tile.x0;
 
-        const int xStart = std::ceil(pxLeft - 0.5f),
-            xEnd = std::ceil(pxRight - 0.5f);
+        for (int i = 0; i < count; ++i)
+        {
+            tile.coveredPixels += zBuffer[ind + i] < 1.0f;
+        }
 
-        const glm::vec3 brScanStep = (brRight - brLeft) / (pxRight - pxLeft);
+        uint8_t *row = buffer + ind * 4;
 
-        glm::vec3 br = brLeft + brScanStep * (xStart - pxLeft + 0.5f);
+        ResolveKernel::Resolve(hdrBuffer + ind * 4, row, count, tonemap);
 
-        for (int x = xStart; x < xEnd; ++x)
+        if (!grade)
         {
-            drawFragment(br, x, y, va, vb, vc);
-
-            br += brScanStep;
+            continue;
         }
 
-        brLeft += brStepLeft;
-        brRight += brStepRight;
-    }
-}
-
-void Renderer::drawFragment(const glm::vec3 br, const int x, const int y,
-                            const Vertex va, const Vertex vb, const Vertex vc)
-{
-    const float z = Interpolate(br, va.v.z, vb.v.z, vc.v.z);
-    glm::vec3 n = InterpolateNormals(br, va.n, vb.n, vc.n),
-        tangent = InterpolateNormals(br, va.tangent, vb.tangent, vc.tangent);
-    const glm::vec3 posView = Interpolate(br, va.posView, vb.posView, vc.posView);
+        for (int i = 0; i < count; ++i)
+        {
+            uint8_t *p = row + i * 4;
 
-    glm::vec2 t;
+            const glm::vec3 c = lut->apply(glm::vec3(p[0], p[1], p[2]) / 255.0f);
 
-    if (perspectiveCorrection)
-    {
-        const float dv = Interpolate(br, 1.0f / va.posView.z, 1.0f / vb.posView.z, 1.0f / vc.posView.z);
-        t = Interpolate(br, va.t / va.posView.z, vb.t / vb.posView.z, vc.t / vc.posView.z) / dv;
-    }
-    else
-    {
-        t = Interpolate(br, va.t, vb.t, vc.t);
+            p[0] = std::round(glm::clamp(c.x, 0.0f, 1.0f) * 255.0f);
+            p[1] = std::round(glm::clamp(c.y, 0.0f, 1.0f) * 255.0f);
+            p[2] = std::round(glm::clamp(c.z, 0.0f, 1.0f) * 255.0f);
+        }
     }
+}
 
-    glm::vec3 baseCol = texDiffuse->getCol(t.x, t.y),
-        pCol;
+void Renderer::allocateBuffers()
+{
+    // aligned rows for the GL upload
+    buffer = new (std::align_val_t(bufferAlignment)) uint8_t[width * height * 4];
+    hdrBuffer = new (std::align_val_t(bufferAlignment)) float[width * height * 4];
+    zBuffer = new float[width * height];
 
-    n = calcNormal(n, tangent, t);
+    blocksX = (width + blockSize - 1) / blockSize;
+    blocksY = (height + blockSize - 1) / blockSize;
+    blockDepth = new float[blocksX * blocksY];
+    visBuffer = new VisibilitySample[width * height];
 
-    switch (shading)
+    for (int i = 0; i < width * height; ++i)
     {
-    case None:
-        pCol = baseCol;
-        break;
-
-    case PBR:
-        pCol = getPBR(n, posView, baseCol, texMetallic->getVal(t.x, t.y),
-                      texRoughness->getVal(t.x, t.y), texAO->getVal(t.x, t.y),
-                      texEmission->getCol(t.x, t.y));
-        break;
-
-    case Smooth:
-        const glm::vec3 bps = calcBlinnPhongShading(posView, n);
-        const glm::vec3 cSpec = texSpecular->getCol(t.x, t.y) * bps.z;
-
-        pCol = baseCol * (bps.x + bps.y) + cSpec;
-        break;
+        visBuffer[i].triangle = VisibilitySample::noTriangle;
     }
-
-    setPixel(x, y, z, pCol);
 }
 
-void Renderer::setPixel(const int x, const int y, const float z, glm::vec3 c)
+void Renderer::freeBuffers()
 {
-    if (x < 0 || x >= width || y < 0 || y >= height)
-    {
-        return;
-    }
-
-    const int ind = index(y, x);
-
-    if (zBuffer[ind] > z)
-    {
-        zBuffer[ind] = z;
-
-        c = glm::min(glm::vec3(1.0f), c);
-
-        buffer[ind * 3] = std::round(c.x * 255.0f);
-        buffer[ind * 3 + 1] = std::round(c.y * 255.0f);
-        buffer[ind * 3 + 2] = std::round(c.z * 255.0f);
-    }
+    ::operator delete[](buffer, std::align_val_t(bufferAlignment));
+    ::operator delete[](hdrBuffer, std::align_val_t(bufferAlignment));
+    delete[] zBuffer;
+    delete[] blockDepth;
+    delete[] visBuffer;
 }
 
 void Renderer::genModelMatrix()
@@ -605,21 +1449,262 @@ void Renderer::renderModel()
         return;
     }
 
-    for (size_t i = 0; i < model->faces.size(); ++i)
+    vertexCache.Resize(model->getVertexCount());
+    clusterTransformed.assign(model->clusters.size(), 0);
+    triangles.clear();
+
+    cullClusters();
+
+    const TileRenderer renderTile = selectTileRenderer();
+
+    renderClusters(firstPassClusters, renderTile);
+
+    if (occlusionCulling)
+    {
+        // the first pass depth stands in for last frame's, reprojected
+        cullOccludedClusters();
+        renderClusters(secondPassClusters, renderTile);
+    }
+}
+
+void Renderer::renderClusters(const std::vector<int>& ids, const TileRenderer renderTile)
+{
+    if (ids.empty())
+    {
+        return;
+    }
+
+    // each cluster's vertices are transformed once per frame, on first use
+    std::vector<int> pending;
+
+    const auto require = [this, &pending](const int id)
+    {
+        if (!clusterTransformed[id])
+        {
+            clusterTransformed[id] = 1;
+            pending.push_back(id);
+        }
+    };
+
+    for (const int id : ids)
+    {
+        require(id);
+
+        for (const int dep : model->clusters[id].dependencies)
+        {
+            require(dep);
+        }
+    }
+
+    transformVertices(pending);
+
+    const size_t first = triangles.size();
+
+    for (const int id : ids)
+    {
+        const Cluster& cl = model->clusters[id];
+
+        for (int i = cl.firstFace; i < cl.firstFace + cl.faceCount; ++i)
+        {
+            setupTriangle(model->faces[i]);
+        }
+    }
+
+    binTriangles(first);
+
+    pool->Run(tiles.size(), [this, renderTile](int i) { (this->*renderTile)(tiles[i]); });
+}
+
+void Renderer::genTiles()
+{
+    tilesX = (width + tileSize - 1) / tileSize;
+    tilesY = (height + tileSize - 1) / tileSize;
+
+    tiles = std::vector<Tile>(tilesX * tilesY);
+
+    for (int i = 0; i < tilesY; ++i)
+    {
+        for (int j = 0; j < tilesX; ++j)
+        {
+            Tile& tile = tiles[i * tilesX + j];
+
+            tile.x0 = j * tileSize;
+            tile.y0 = i * tileSize;
+            tile.x1 = std::min(tile.x0 + tileSize, width);
+            tile.y1 = std::min(tile.y0 + tileSize, height);
+        }
+    }
+}
+
+void Renderer::binTriangles(const size_t first)
+{
+    for (Tile& tile : tiles)
+    {
+        tile.triangles.clear();
+    }
+
+    for (size_t i = first; i < triangles.size(); ++i)
+    {
+        const Triangle& tr = triangles[i];
+
+        const int tx0 = tr.xMin / tileSize,
+            tx1 = (tr.xMax - 1) / tileSize,
+            ty0 = tr.yMin / tileSize,
+            ty1 = (tr.yMax - 1) / tileSize;
+
+        for (int ty = ty0; ty <= ty1; ++ty)
+        {
+            for (int tx = tx0; tx <= tx1; ++tx)
+            {
+                Tile& tile = tiles[ty * tilesX + tx];
+
+                // tiles keep the depth of the passes before, so the second occlusion
+                // pass drops most hidden triangles here. The shading pass test is the
+                // loosest one, the tile's own pass tests again as its depth shrinks
+                if (!occluded<ShadingPass>(tr.zMin, tile.maxDepth))
+                {
+                    tile.triangles.push_back(i);
+                }
+            }
+        }
+    }
+}
+
+Renderer::TileRenderer Renderer::selectTileRenderer() const
+{
+    const bool normalMap = !texNormal->isDefault(),
+        emissionMap = !texEmission->isDefault();
+
+    switch (shading)
+    {
+    case PBR:
+        return selectTileRenderer<PBR>(perspectiveCorrection, normalMap, emissionMap,
+                                       mipmapping);
+
+    case Smooth:
+        return selectTileRenderer<Smooth>(perspectiveCorrection, normalMap, false,
+                                          mipmapping);
+
+    default:
+        return selectTileRenderer<None>(perspectiveCorrection, false, false,
+                                        mipmapping);
+    }
+}
+
+template<Shading S>
+Renderer::TileRenderer Renderer::selectTileRenderer(const bool perspectiveCorrection,
+                                                    const bool normalMap,
+                                                    const bool emissionMap,
+                                                    const bool mipmapping)
+{
+    static const TileRenderer variants[16] =
+    {
+        &Renderer::renderTile<FragmentKernel<S, false, false, false, false>>,
+        &Renderer::renderTile<FragmentKernel<S, false, false, false, true>>,
+        &Renderer::renderTile<FragmentKernel<S, false, false, true, false>>,
+        &Renderer::renderTile<FragmentKernel<S, false, false, true, true>>,
+        &Renderer::renderTile<FragmentKernel<S, false, true, false, false>>,
+        &Renderer::renderTile<FragmentKernel<S, false, true, false, true>>,
+        &Renderer::renderTile<FragmentKernel<S, false, true, true, false>>,
+        &Renderer::renderTile<FragmentKernel<S, false, true, true, true>>,
+        &Renderer::renderTile<FragmentKernel<S, true, false, false, false>>,
+        &Renderer::renderTile<FragmentKernel<S, true, false, false, true>>,
+        &Renderer::renderTile<FragmentKernel<S, true, false, true, false>>,
+        &Renderer::renderTile<FragmentKernel<S, true, false, true, true>>,
+        &Renderer::renderTile<FragmentKernel<S, true, true, false, false>>,
+        &Renderer::renderTile<FragmentKernel<S, true, true, false, true>>,
+        &Renderer::renderTile<FragmentKernel<S, true, true, true, false>>,
+        &Renderer::renderTile<FragmentKernel<S, true, true, true, true>>
+    };
+
+    return variants[perspectiveCorrection * 8 + normalMap * 4 + emissionMap * 2 + mipmapping];
+}
+
+template<class V>
+void Renderer::renderTile(Tile& tile)
+{
+    if (deferredShading)
+    {
+        for (const int i : tile.triangles)
+        {
+            drawTriangle<V, VisibilityPass>(i, tile);
+        }
+
+        tile.fragments += shadeTile<V>(tile);
+        return;
+    }
+
+    if (!depthPrepass)
+    {
+        for (const int i : tile.triangles)
+        {
+            tile.fragments += drawTriangle<V, ForwardPass>(i, tile);
+        }
+
+        return;
+    }
+
+    for (const int i : tile.triangles)
+    {
+        drawTriangle<V, DepthPrepass>(i, tile);
+    }
+
+    for (const int i : tile.triangles)
+    {
+        tile.fragments += drawTriangle<V, ShadingPass>(i, tile);
+    }
+}
+
+template<class V>
+int Renderer::shadeTile(const Tile& tile)
+{
+    int shaded = 0;
+
+    PBRPacket packet;
+    packet.count = 0;
+
+    for (int y = tile.y0; y < tile.y1; ++y)
     {
-        const Face f = model->faces[i];
+        for (int x = tile.x0; x < tile.x1; ++x)
+        {
+            const int ind = index(y, x);
+            VisibilitySample& vs = visBuffer[ind];
+
+            if (vs.triangle == VisibilitySample::noTriangle)
+            {
+                continue;
+            }
+
+            const Triangle& tr = triangles[vs.triangle];
 
-        Vertex va, vb, vc;
-        model->getVertices(f, va, vb, vc);
+            // neighbours may belong to other triangles, so each pixel is evaluated directly
+            float attr[AttributeCount];
+
+            evalAttributes<V>(tr, x, y, attr);
+            drawFragment<V>(tr, attr, x, y, zBuffer[ind], packet);
+            ++shaded;
+
+            // leave the buffer cleared for the next frame
+            vs.triangle = VisibilitySample::noTriangle;
+        }
+    }
 
-        drawTriangle(va, vb, vc);
+    if constexpr (V::shading == PBR)
+    {
+        flushPacket(packet);
     }
+
+    return shaded;
 }
 
 void Renderer::genViewportMatrix()
 {
     using glm::vec4;
 
+    // keeps clipped screen coordinates within guardBand pixels of the origin
+    guardX = 2.0f * guardBand / width - 1.0f;
+    guardY = 2.0f * guardBand / height - 1.0f;
+
     viewportMat = glm::mat4(width / 2.0f, 0.0f, 0.0f, 0.0f,
                             0.0f, -height / 2.0f, 0.0f, 0.0f,
                             0.0f, 0.0f, 1.0f, 0.0f,
@@ -633,7 +1718,16 @@ void Renderer::LoadModel(const std::string& filename)
         delete model;
     }
 
-    model = new Model("model" + filename + ".obj");
+    updatePool();
+
+    model = new Model("model" + filename + ".obj", optimizeModel, compressModelCache, *pool);
+
+    if (quantizeVertices)
+    {
+        model->quantizeAttributes(*pool);
+    }
+
+    visibleLastFrame.clear();
 }
 
 void Renderer::LoadDiffuse(const std::string& filename)
@@ -644,6 +1738,8 @@ void Renderer::LoadDiffuse(const std::string& filename)
     }
 
     texDiffuse = new Texture("diffuse" + filename + ".png", Diffuse);
+
+    invalidateMaterial();
 }
 
 void Renderer::LoadSpecular(const std::string& filename)
@@ -663,7 +1759,11 @@ void Renderer::LoadNormal(const std::string& filename)
         delete texNormal;
     }
 
-    texNormal = new NormalTexture("normal" + filename + ".png");
+    updatePool();
+
+    texNormal = new NormalTexture("normal" + filename + ".png", *pool);
+
+    invalidateMaterial();
 }
 
 void Renderer::LoadEmission(const std::string& filename)
@@ -674,6 +1774,8 @@ void Renderer::LoadEmission(const std::string& filename)
     }
 
     texEmission = new Texture("emission" + filename + ".png", Emission);
+
+    invalidateMaterial();
 }
 
 void Renderer::LoadMetallic(const std::string& filename)
@@ -684,6 +1786,8 @@ void Renderer::LoadMetallic(const std::string& filename)
     }
 
     texMetallic = new MonoTexture("metallic" + filename + ".png", Metallic);
+
+    invalidateMaterial();
 }
 
 void Renderer::LoadRoughness(const std::string& filename)
@@ -694,6 +1798,8 @@ void Renderer::LoadRoughness(const std::string& filename)
     }
 
     texRoughness = new MonoTexture("roughness" + filename + ".png", Roughness);
+
+    invalidateMaterial();
 }
 
 void Renderer::LoadAO(const std::string& filename)
@@ -704,6 +1810,37 @@ void Renderer::LoadAO(const std::string& filename)
     }
 
     texAO = new MonoTexture("ao" + filename + ".png", Ambient);
+
+    invalidateMaterial();
+}
+
+void Renderer::LoadLUT(const std::string& filename)
+{
+    delete lut;
+
+    lut = new ColorLUT("lut" + filename + ".cube");
+}
+
+void Renderer::updatePool()
+{
+    threadCount = std::max(1, threadCount);
+
+    if (pool == nullptr || pool->GetThreadCount() != threadCount)
+    {
+        delete pool;
+        pool = new ThreadPool(threadCount);
+    }
+}
+
+void Renderer::invalidateMaterial()
+{
+    delete material;
+    material = nullptr;
+}
+
+int Renderer::blockIndex(const int bx, const int by) const
+{
+    return (by / blockSize) * blocksX + bx / blockSize;
 }
 
 int Renderer::index(int i, int j) const
@@ -711,11 +1848,10 @@ int Renderer::index(int i, int j) const
     return i * width + j;
 }
 
-glm::vec3 Renderer::calcNormal(const glm::vec3 n, glm::vec3 tangent, const glm::vec2 t)
+glm::vec3 Renderer::calcNormal(const glm::vec3 n, glm::vec3 tangent, glm::vec3 mapNormal)
 {
     tangent = glm::normalize(tangent - glm::dot(tangent, n) * n);
     const glm::vec3 bitangent = glm::cross(tangent, n);
-    glm::vec3 mapNormal = texNormal->getNormal(t.x, t.y);
 
     const glm::mat3 tbn(tangent, bitangent, n);
 
@@ -740,52 +1876,6 @@ glm::vec3 Renderer::calcBlinnPhongShading(const glm::vec3 p, const glm::vec3 n)
     return glm::vec3(l2, std::max(0.0f, l1), kSp);
 }
 
-glm::vec3 Renderer::getPBR(glm::vec3 n, glm::vec3 pos, glm::vec3 albedo,
-                           float metallic, float roughness, float ao,
-                           glm::vec3 emission)
-{
-    albedo = glm::pow(albedo, glm::vec3(2.2f));
-    const glm::vec3 l = -lightVecView,
-        v = glm::normalize(-pos),
-        h = glm::normalize(v + l),
-        F0 = glm::mix(glm::vec3(0.04f), albedo, metallic),
-        F = Utils::FresnelSchlick(std::max(glm::dot(h, v), 0.0f), F0);
-
-    const float NDF = Utils::DistributionGGX(h, n, roughness),
-        G = Utils::GeometrySmith(n, v, l, roughness),
-        NdotL = std::max(glm::dot(n, l), 0.0f);
-
-    const glm::vec3 numerator = NDF * G * F;
-    float denominator = 4.0f * std::max(glm::dot(n, v), 0.0f) * NdotL;
-
-    denominator = std::max(denominator, 0.000001f);
-
-    const glm::vec3 specular = numerator / denominator;
-
-    const glm::vec3& kS = F;
-    const glm::vec3 kD = (1.0f - kS) * (1.0f - metallic),
-        Lo = emission + (kD * albedo / Utils::pi + specular) * NdotL,
-        ambient = glm::vec3(0.03f) * albedo * ao;
-
-    glm::vec3 color = ambient + Lo;
-
-    color = color / (color + 1.0f);
-    color = glm::pow(color, glm::vec3(1.0f / 2.2f));
-
-    return color;
-}
-
-template<typename T>
-T Renderer::Interpolate(const glm::vec3 br, const T a, const T b, const T c)
-{
-    return a * br.x + b * br.y + c * br.z;
-}
-
-glm::vec3 Renderer::InterpolateNormals(const glm::vec3 br, const glm::vec3 a, const glm::vec3 b, const glm::vec3 c)
-{
-    return glm::normalize(a * br.x + b * br.y + c * br.z);
-}
-
 bool Renderer::canCull(const glm::vec2 a, const glm::vec2 b, const glm::vec2 c)
 {
     const float cull = Utils::perpDotProduct(b - a, c - a);
@@ -0,0 +1,114 @@
+#include "ResolveKernel.hpp"
+#include "PBRKernel.hpp"
+#include "GammaTable.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+void ResolveKernel::Resolve(const float* src, uint8_t* dst, const int count, const bool tonemap)
+{
+    static const bool avx2 = PBRKernel::HasAVX2();
+
+    if (avx2)
+    {
+        ResolveAVX2(src, dst, count, tonemap);
+    }
+    else
+    {
+        ResolveScalar(src, dst, count, tonemap);
+    }
+}
+
+void ResolveKernel::ResolveScalar(const float* src, uint8_t* dst, const int count,
+                                  const bool tonemap)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            const float v = src[i * 4 + c];
+
+            dst[i * 4 + c] = tonemap ? GammaTable::Encode(v / (v + 1.0f)) :
+                std::round(std::clamp(v, 0.0f, 1.0f) * 255.0f);
+        }
+
+        dst[i * 4 + 3] = 255;
+    }
+}
+
+#ifdef __x86_64__
+
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+
+// two pixels of channel values to bytes
+static inline AVX2_TARGET __m256i encodeAVX2(__m256 v, const bool tonemap)
+{
+    if (!tonemap)
+    {
+        v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+
+        return _mm256_cvttps_epi32(_mm256_fmadd_ps(v, _mm256_set1_ps(255.0f),
+                                                   _mm256_set1_ps(0.5f)));
+    }
+
+    v = _mm256_div_ps(v, _mm256_add_ps(v, _mm256_set1_ps(1.0f)));
+
+    // same lookup as GammaTable::Encode
+    const __m256i index = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(v),
+                                                             23 - GammaTable::mantissaBits),
+                                           _mm256_set1_epi32(GammaTable::firstIndex));
+
+    const __m256i clamped = _mm256_min_epi32(_mm256_max_epi32(index, _mm256_setzero_si256()),
+                                             _mm256_set1_epi32(GammaTable::encodeSize - 1));
+
+    const __m256i encoded = _mm256_and_si256(
+        _mm256_i32gather_epi32(reinterpret_cast<const int*>(GammaTable::EncodeTable()),
+                               clamped, 1),
+        _mm256_set1_epi32(0xFF));
+
+    const __m256 low = _mm256_cmp_ps(v, _mm256_set1_ps(1.0f / (1 << GammaTable::octaves)),
+                                     _CMP_GE_OQ),
+        high = _mm256_cmp_ps(v, _mm256_set1_ps(1.0f), _CMP_GE_OQ);
+
+    return _mm256_or_si256(_mm256_and_si256(encoded, _mm256_castps_si256(low)),
+                           _mm256_and_si256(_mm256_castps_si256(high), _mm256_set1_epi32(255)));
+}
+
+AVX2_TARGET void ResolveKernel::ResolveAVX2(const float* src, uint8_t* dst, const int count,
+                                            const bool tonemap)
+{
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const __m128i alpha = _mm_set1_epi32(0xFF000000);
+
+    int i = 0;
+
+    // four pixels per iteration
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256i a = encodeAVX2(_mm256_loadu_ps(src + i * 4), tonemap),
+            b = encodeAVX2(_mm256_loadu_ps(src + i * 4 + 8), tonemap);
+
+        // in lane packs leave the pixels as 0, 2 | 1, 3
+        __m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(a, b), _mm256_setzero_si256());
+        bytes = _mm256_permutevar8x32_epi32(bytes, order);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4),
+                         _mm_or_si128(_mm256_castsi256_si128(bytes), alpha));
+    }
+
+    ResolveScalar(src + i * 4, dst + i * 4, count - i, tonemap);
+}
+
+#else
+
+void ResolveKernel::ResolveAVX2(const float* src, uint8_t* dst, const int count,
+                                const bool tonemap)
+{
+    ResolveScalar(src, dst, count, tonemap);
+}
+
+#endif
@@ -9,6 +9,9 @@ Texture::Texture(const std::string& filename, TextureType type)
 {
     width = 0;
     height = 0;
+    defaultMap = false;
+
+    std::vector<unsigned char> data;
 
     unsigned error = lodepng::decode(data, width, height, filename, LCT_RGB);
 
@@ -20,6 +23,8 @@ Texture::Texture(const std::string& filename, TextureType type)
     {
         printf("Failed to load texture:\n");
 
+        defaultMap = true;
+
         switch (type)
         {
         case Diffuse:
@@ -55,20 +60,46 @@ Texture::Texture(const std::string& filename, TextureType type)
     }
 
     printf("width: %d height: %d\n\n", width, height);
+
+    texels.resize(mips.Init(width, height));
+
+    mips.Fill(texels, [&data](size_t i)
+    {
+        return glm::u8vec3(data[i * 3], data[i * 3 + 1], data[i * 3 + 2]);
+    });
+
+    mips.Build(texels, [](glm::u8vec3 a, glm::u8vec3 b, glm::u8vec3 c, glm::u8vec3 d)
+    {
+        return glm::u8vec3((glm::uvec3(a) + glm::uvec3(b) + glm::uvec3(c) + glm::uvec3(d) + 2u) / 4u);
+    });
 }
 
 glm::vec3 Texture::getCol(float x, float y)
 {
-    using glm::vec2;
-    using glm::clamp;
+    return mips.SampleNearest<glm::vec3>(x, y, [this](size_t i) { return fetch(i); });
+}
+
+glm::vec3 Texture::getCol(float x, float y, float lod)
+{
+    return mips.SampleTrilinear<glm::vec3>(x, y, lod, [this](size_t i) { return fetch(i); });
+}
 
-    x = std::clamp(x, 0.0f, 1.0f);
-    y = std::clamp(y, 0.0f, 1.0f);
+glm::vec3 Texture::fetch(const size_t i) const
+{
+    return glm::vec3(texels[i]) / 255.0f;
+}
 
-    const int newX = round(x * (width - 1)),
-        newY = round(y * (height - 1));
+bool Texture::isDefault() const
+{
+    return defaultMap;
+}
 
-    const int ind = (newY * width + newX) * 3;
+unsigned Texture::getWidth() const
+{
+    return width;
+}
 
-    return glm::vec3(data[ind], data[ind + 1], data[ind + 2]) / 255.0f;
+unsigned Texture::getHeight() const
+{
+    return height;
 }
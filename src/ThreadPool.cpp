@@ -0,0 +1,106 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(int threadCount)
+{
+    job = nullptr;
+    nextJob = 0;
+    jobCount = 0;
+    activeWorkers = 0;
+    generation = 0;
+    stopping = false;
+
+    for (int i = 1; i < threadCount; ++i)
+    {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    cvStart.notify_all();
+
+    for (std::thread& t : workers)
+    {
+        t.join();
+    }
+}
+
+int ThreadPool::GetThreadCount() const
+{
+    return workers.size() + 1;
+}
+
+void ThreadPool::Run(int jobCount, const std::function<void(int)>& job)
+{
+    if (workers.empty())
+    {
+        for (int i = 0; i < jobCount; ++i)
+        {
+            job(i);
+        }
+
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        this->job = &job;
+        this->jobCount = jobCount;
+        nextJob = 0;
+        activeWorkers = workers.size();
+        ++generation;
+    }
+
+    cvStart.notify_all();
+
+    runJobs();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    cvDone.wait(lock, [this] { return activeWorkers == 0; });
+
+    this->job = nullptr;
+}
+
+void ThreadPool::workerLoop()
+{
+    unsigned seenGeneration = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cvStart.wait(lock, [this, seenGeneration]
+                         { return stopping || generation != seenGeneration; });
+
+            if (stopping)
+            {
+                return;
+            }
+
+            seenGeneration = generation;
+        }
+
+        runJobs();
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (--activeWorkers == 0)
+        {
+            cvDone.notify_one();
+        }
+    }
+}
+
+void ThreadPool::runJobs()
+{
+    for (int i = nextJob++; i < jobCount; i = nextJob++)
+    {
+        (*job)(i);
+    }
+}
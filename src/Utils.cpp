@@ -1,6 +1,8 @@
 #include "Utils.hpp"
 
 #include <windows.h>
+#include <algorithm>
+#include <cmath>
 
 float Utils::perpDotProduct(const glm::vec2 a, const glm::vec2 b)
 {
@@ -44,3 +46,46 @@ glm::vec3 Utils::FresnelSchlick(float cosTheta, glm::vec3 F0)
 {
     return F0 + (1.0f - F0) * std::pow(1.0f - cosTheta, 5.0f);
 }
+
+glm::vec2 Utils::OctEncode(glm::vec3 n)
+{
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+
+    glm::vec2 e(n.x, n.y);
+
+    // fold the lower hemisphere over the diagonals
+    if (n.z < 0.0f)
+    {
+        e = (1.0f - glm::abs(glm::vec2(e.y, e.x))) *
+            glm::vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    return e;
+}
+
+glm::vec3 Utils::OctDecode(const glm::vec2 e)
+{
+    glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+
+    const float t = std::max(-n.z, 0.0f);
+
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+
+    return glm::normalize(n);
+}
+
+glm::u16vec2 Utils::PackNormal(const glm::vec3 n)
+{
+    const float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+
+    // zero and non-finite vectors have no direction, they get +z
+    const glm::vec2 e = sum > 0.0f && std::isfinite(sum) ? OctEncode(n) : glm::vec2(0.0f);
+
+    return glm::u16vec2(glm::round((e * 0.5f + 0.5f) * 65535.0f));
+}
+
+glm::vec3 Utils::UnpackNormal(const glm::u16vec2 e)
+{
+    return OctDecode(glm::vec2(e) * (2.0f / 65535.0f) - 1.0f);
+}
@@ -7,9 +7,8 @@ Vertex Vertex::Combine(const Vertex a, const Vertex b, const float ratio)
     res.v = a.v * (1.0f - ratio) + b.v * ratio;
     res.n = a.n * (1.0f - ratio) + b.n * ratio;
     res.posView = a.posView * (1.0f - ratio) + b.posView * ratio;
-
-    const float dv = (1.0f - ratio) / a.posView.z + ratio / b.posView.z;
-    res.t = (a.t * (1.0f - ratio) / a.posView.z + b.t * ratio / b.posView.z) / dv;
+    res.tangent = a.tangent * (1.0f - ratio) + b.tangent * ratio;
+    res.t = a.t * (1.0f - ratio) + b.t * ratio;
 
     return res;
 }
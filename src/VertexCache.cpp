@@ -0,0 +1,13 @@
+#include "VertexCache.hpp"
+
+void VertexCache::Resize(const size_t vertexCount)
+{
+    for (std::vector<float>* v : {&viewX, &viewY, &viewZ,
+                                  &clipX, &clipY, &clipZ, &clipW,
+                                  &screenX, &screenY, &screenZ,
+                                  &normalX, &normalY, &normalZ,
+                                  &tangentX, &tangentY, &tangentZ})
+    {
+        v->resize(vertexCount);
+    }
+}
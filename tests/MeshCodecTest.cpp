@@ -0,0 +1,203 @@
+#include "MeshCodec.hpp"
+#include "MeshCache.hpp"
+#include "Model.hpp"
+#include "Utils.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+static int failures = 0;
+
+static void check(const bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+// UV sphere with normals and texture coordinates
+static bool writeSphere(const char* filename, const int rings, const int segments)
+{
+    FILE *file = fopen(filename, "w");
+
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    for (int i = 0; i <= rings; ++i)
+    {
+        const float theta = Utils::pi * i / rings;
+
+        for (int j = 0; j <= segments; ++j)
+        {
+            const float phi = 2.0f * Utils::pi * j / segments;
+            const glm::vec3 n(std::sin(theta) * std::cos(phi), std::cos(theta),
+                              std::sin(theta) * std::sin(phi));
+
+            fprintf(file, "v %f %f %f\n", 3.0f * n.x + 1.0f, 3.0f * n.y, 3.0f * n.z - 2.0f);
+            fprintf(file, "vt %f %f\n", (float)j / segments, (float)i / rings);
+            fprintf(file, "vn %f %f %f\n", n.x, n.y, n.z);
+        }
+    }
+
+    for (int i = 0; i < rings; ++i)
+    {
+        for (int j = 0; j < segments; ++j)
+        {
+            const int a = i * (segments + 1) + j + 1, b = a + segments + 1;
+
+            fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, a + 1, a + 1, a + 1);
+            fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a + 1, a + 1, a + 1, b, b, b,
+                    b + 1, b + 1, b + 1);
+        }
+    }
+
+    return fclose(file) == 0;
+}
+
+// largest distance between a value and the nearest point of the 16 bit grid
+// over [lo, hi], with slack for float rounding
+template<int N>
+static glm::vec<N, float> quantizationStep(const std::vector<glm::vec<N, float>>& values)
+{
+    glm::vec<N, float> lo(FLT_MAX), hi(-FLT_MAX);
+
+    for (const glm::vec<N, float>& v : values)
+    {
+        lo = glm::min(lo, v);
+        hi = glm::max(hi, v);
+    }
+
+    return (hi - lo) / 65535.0f * 0.5f + glm::max(glm::abs(lo), glm::abs(hi)) * 1e-6f;
+}
+
+// encodes a model, decodes it back and checks the lossy attributes stay
+// within their quantization error and the faces come back identical
+int main()
+{
+    const char *filename = "MeshCodecTest.obj";
+
+    if (!writeSphere(filename, 64, 128))
+    {
+        printf("Could not write %s\n", filename);
+        return EXIT_FAILURE;
+    }
+
+    ThreadPool pool(4);
+
+    const Model original(filename, true, false, pool);
+
+    remove(filename);
+    remove(MeshCache::CacheFilename(filename).c_str());
+
+    check(!original.faces.empty() && !original.clusters.empty(), "model loaded");
+
+    std::vector<char> data;
+
+    check(MeshCodec::Encode(original, data), "encode");
+
+    Model decoded(original);
+
+    decoded.vertices.clear();
+    decoded.normals.clear();
+    decoded.tangents.clear();
+    decoded.uvs.clear();
+    decoded.faces.clear();
+
+    // best of several runs, a single decode of a small model is too short to time
+    double seconds = 1e30;
+    bool decodedOk = true;
+
+    for (int i = 0; i < 20; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        decodedOk = MeshCodec::Decode(data.data(), data.size(), decoded, pool) && decodedOk;
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        seconds = std::min(seconds, elapsed.count());
+    }
+
+    check(decodedOk, "decode");
+    check(decoded.vertices.size() == original.vertices.size() &&
+          decoded.normals.size() == original.vertices.size() &&
+          decoded.tangents.size() == original.vertices.size() &&
+          decoded.uvs.size() == original.vertices.size(), "vertex count");
+    check(decoded.faces.size() == original.faces.size(), "face count");
+
+    if (failures > 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    bool facesMatch = true;
+
+    for (size_t i = 0; i < original.faces.size(); ++i)
+    {
+        facesMatch = facesMatch && original.faces[i].vertices == decoded.faces[i].vertices;
+    }
+
+    check(facesMatch, "faces identical");
+
+    const glm::vec3 positionStep = quantizationStep(original.vertices);
+    const glm::vec2 uvStep = quantizationStep(original.uvs);
+
+    bool positionsMatch = true, uvsMatch = true;
+    // chord lengths, acos of a dot product close to 1 is too coarse in float
+    float normalChord = 0.0f, tangentChord = 0.0f;
+
+    for (size_t i = 0; i < original.vertices.size(); ++i)
+    {
+        const glm::vec3 dp = glm::abs(original.vertices[i] - decoded.vertices[i]);
+        const glm::vec2 duv = glm::abs(original.uvs[i] - decoded.uvs[i]);
+
+        for (int k = 0; k < 3; ++k)
+        {
+            positionsMatch = positionsMatch && dp[k] <= positionStep[k];
+        }
+
+        for (int k = 0; k < 2; ++k)
+        {
+            uvsMatch = uvsMatch && duv[k] <= uvStep[k];
+        }
+
+        normalChord = std::max(normalChord, glm::length(glm::normalize(original.normals[i]) -
+                                                        decoded.normals[i]));
+        tangentChord = std::max(tangentChord, glm::length(glm::normalize(original.tangents[i]) -
+                                                          decoded.tangents[i]));
+    }
+
+    const float normalError = 2.0f * std::asin(normalChord * 0.5f) * 180.0f / Utils::pi,
+        tangentError = 2.0f * std::asin(tangentChord * 0.5f) * 180.0f / Utils::pi;
+
+    check(positionsMatch, "positions within half a quantization step");
+    check(uvsMatch, "uvs within half a quantization step");
+    // 16 bit octahedral coordinates are good to a few thousandths of a degree
+    check(normalError < 0.01f, "normal angle error");
+    check(tangentError < 0.01f, "tangent angle error");
+
+    // truncated data must be rejected rather than read past
+    Model truncated(original);
+
+    check(!MeshCodec::Decode(data.data(), data.size() - 1, truncated, pool), "truncated data");
+
+    // what the uncompressed cache stores for the same model
+    const double rawBytes = original.vertices.size() *
+        (3 * sizeof(glm::vec3) + sizeof(glm::vec2)) + original.faces.size() * sizeof(Face);
+
+    printf("%d vertices, %d faces. Normal error %.4f deg, tangent %.4f deg\n",
+           (int)original.vertices.size(), (int)original.faces.size(), normalError, tangentError);
+    printf("Raw %.2f MB, encoded %.2f MB, ratio %.2f. Decode %.3f ms, %.2f GB/s of raw data\n",
+           rawBytes / 1e6, data.size() / 1e6, rawBytes / data.size(), seconds * 1e3,
+           rawBytes / 1e9 / std::max(seconds, 1e-9));
+
+    return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
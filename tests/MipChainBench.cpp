@@ -0,0 +1,440 @@
+#include "MipChain.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// row-major levels, the layout MipChain used before tiling,
+// sampled with the same filtering as MipChain::SampleTrilinear
+class LinearChain
+{
+    public:
+        size_t Init(const int width, const int height)
+        {
+            size_t size = 0;
+            MipLevel level = {width, height, 0, 0};
+
+            while (true)
+            {
+                level.offset = size;
+                levels.push_back(level);
+
+                size += static_cast<size_t>(level.width) * level.height;
+
+                if (level.width <= 1 && level.height <= 1)
+                {
+                    break;
+                }
+
+                level.width = std::max(level.width / 2, 1);
+                level.height = std::max(level.height / 2, 1);
+            }
+
+            sizeLog2 = std::log2(static_cast<float>(std::max(width, height)));
+
+            return size;
+        }
+
+        size_t Index(const int level, const int x, const int y) const
+        {
+            const MipLevel& l = levels[level];
+
+            return l.offset + static_cast<size_t>(y) * l.width + x;
+        }
+
+        template<class R, class Fetch>
+        R SampleTrilinear(const float x, const float y, float lod, Fetch fetch) const
+        {
+            const int maxLevel = levels.size() - 1;
+
+            lod += sizeLog2;
+
+            if (!(lod > 0.0f))
+            {
+                return sampleBilinear<R>(0, x, y, fetch);
+            }
+
+            if (lod >= maxLevel)
+            {
+                return sampleBilinear<R>(maxLevel, x, y, fetch);
+            }
+
+            const int level = lod;
+            const float t = lod - level;
+
+            const R a = sampleBilinear<R>(level, x, y, fetch),
+                b = sampleBilinear<R>(level + 1, x, y, fetch);
+
+            return a + (b - a) * t;
+        }
+
+        std::vector<MipLevel> levels;
+
+    private:
+        template<class R, class Fetch>
+        R sampleBilinear(const int level, float x, float y, Fetch fetch) const
+        {
+            const MipLevel& l = levels[level];
+
+            x = std::clamp(x, 0.0f, 1.0f) * l.width - 0.5f;
+            y = std::clamp(y, 0.0f, 1.0f) * l.height - 0.5f;
+
+            const int ix = static_cast<int>(x + 1.0f) - 1,
+                iy = static_cast<int>(y + 1.0f) - 1;
+
+            const float tx = x - ix,
+                ty = y - iy;
+
+            const int x0 = std::max(ix, 0),
+                y0 = std::max(iy, 0),
+                x1 = std::min(ix + 1, l.width - 1),
+                y1 = std::min(iy + 1, l.height - 1);
+
+            // rows computed once, as MipChain does
+            const size_t row0 = l.offset + static_cast<size_t>(y0) * l.width,
+                row1 = l.offset + static_cast<size_t>(y1) * l.width;
+
+            const R a = fetch(row0 + x0),
+                b = fetch(row0 + x1),
+                c = fetch(row1 + x0),
+                d = fetch(row1 + x1);
+
+            const R top = a + (b - a) * tx,
+                bottom = c + (d - c) * tx;
+
+            return top + (bottom - top) * ty;
+        }
+
+        float sizeLog2;
+};
+
+// set associative cache with LRU replacement and 64 byte lines
+class CacheModel
+{
+    public:
+        CacheModel(const size_t bytes, const int ways) :
+            ways(ways), sets(bytes / 64 / ways), tags(sets * ways, UINT64_MAX)
+        {
+        }
+
+        // true on a miss
+        bool Access(const uint64_t address)
+        {
+            const uint64_t line = address / 64;
+            uint64_t *set = tags.data() + (line % sets) * ways;
+
+            int way = 0;
+
+            while (way < ways - 1 && set[way] != line)
+            {
+                ++way;
+            }
+
+            const bool miss = set[way] != line;
+
+            // most recent first
+            std::memmove(set + 1, set, way * sizeof(uint64_t));
+            set[0] = line;
+
+            return miss;
+        }
+
+    private:
+        int ways;
+        size_t sets;
+        std::vector<uint64_t> tags;
+};
+
+// hardware L1 data and last level cache read misses of this thread,
+// -1 where the counters are unavailable
+class MissCounters
+{
+    public:
+        MissCounters()
+        {
+#ifdef __linux__
+            l1 = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+            llc = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+                       (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#endif
+        }
+
+        ~MissCounters()
+        {
+#ifdef __linux__
+            for (const int fd : {l1, llc})
+            {
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+            }
+#endif
+        }
+
+        void Start()
+        {
+#ifdef __linux__
+            for (const int fd : {l1, llc})
+            {
+                if (fd >= 0)
+                {
+                    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+#endif
+        }
+
+        void Stop(long long& l1Misses, long long& llcMisses)
+        {
+            l1Misses = read(l1);
+            llcMisses = read(llc);
+        }
+
+    private:
+        int l1 = -1, llc = -1;
+
+        static int open(const uint32_t type, const uint64_t config)
+        {
+#ifdef __linux__
+            perf_event_attr attr;
+
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+            return -1;
+#endif
+        }
+
+        static long long read(const int fd)
+        {
+#ifdef __linux__
+            long long count;
+
+            if (fd >= 0 && ioctl(fd, PERF_EVENT_IOC_DISABLE, 0) == 0 &&
+                ::read(fd, &count, sizeof(count)) == sizeof(count))
+            {
+                return count;
+            }
+#endif
+            return -1;
+        }
+};
+
+struct Result
+{
+    double msamples;
+    // per 1000 samples, simulated and hardware
+    double l1Misses, l2Misses, hardwareL1, hardwareLLC;
+};
+
+static glm::vec3 unpack(const uint32_t c)
+{
+    return glm::vec3(c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF) / 255.0f;
+}
+
+constexpr int screenWidth = 1920, screenHeight = 1080;
+
+// samples a textured quad covering a screen of 8x8 pixel blocks, in the order
+// the rasterizer visits them. The quad is rotated by angle degrees and shows
+// the whole texture scaled by 1 / minification, lod follows the scale
+template<class Chain, class Fetch>
+static void walk(const Chain& chain, const float angle, const float minification,
+                 Fetch fetch, glm::vec3& sum)
+{
+    const float a = glm::radians(angle),
+        scale = minification / screenWidth;
+    const glm::vec2 du = glm::vec2(std::cos(a), std::sin(a)) * scale,
+        dv = glm::vec2(-std::sin(a), std::cos(a)) * scale;
+    const float lod = std::log2(scale);
+
+    for (int by = 0; by < screenHeight; by += 8)
+    {
+        for (int bx = 0; bx < screenWidth; bx += 8)
+        {
+            for (int y = by; y < by + 8; ++y)
+            {
+                for (int x = bx; x < bx + 8; ++x)
+                {
+                    const glm::vec2 p = glm::vec2(x - screenWidth / 2, y - screenHeight / 2),
+                        uv = glm::fract(glm::vec2(0.5f) + du * p.x + dv * p.y);
+
+                    sum += chain.template SampleTrilinear<glm::vec3>(uv.x, uv.y, lod, fetch);
+                }
+            }
+        }
+    }
+}
+
+template<class Chain>
+static Result run(const Chain& chain, const std::vector<uint32_t>& texels, const float angle,
+                  const float minification, glm::vec3& sum)
+{
+    constexpr int repeats = 4;
+    constexpr double samples = static_cast<double>(screenWidth) * screenHeight;
+
+    Result result;
+
+    MissCounters counters;
+    long long l1 = 0, llc = 0;
+
+    const auto fetch = [&texels](size_t i) { return unpack(texels[i]); };
+
+    counters.Start();
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (int r = 0; r < repeats; ++r)
+    {
+        walk(chain, angle, minification, fetch, sum);
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    counters.Stop(l1, llc);
+
+    result.msamples = samples * repeats / elapsed.count() / 1e6;
+    result.hardwareL1 = l1 < 0 ? -1.0 : l1 / (samples * repeats) * 1000.0;
+    result.hardwareLLC = llc < 0 ? -1.0 : llc / (samples * repeats) * 1000.0;
+
+    // 32 KB 8 way L1 and 1 MB 16 way L2, fed with the texel reads only
+    CacheModel l1Model(32 << 10, 8), l2Model(1 << 20, 16);
+    size_t l1Misses = 0, l2Misses = 0;
+
+    walk(chain, angle, minification, [&](size_t i)
+    {
+        const uint64_t address = reinterpret_cast<uintptr_t>(texels.data() + i);
+
+        if (l1Model.Access(address))
+        {
+            ++l1Misses;
+            l2Misses += l2Model.Access(address);
+        }
+
+        return unpack(texels[i]);
+    }, sum);
+
+    result.l1Misses = l1Misses / samples * 1000.0;
+    result.l2Misses = l2Misses / samples * 1000.0;
+
+    return result;
+}
+
+// compares trilinear sampling of the tiled MipChain layout with row-major levels
+int main()
+{
+    constexpr int size = 4096;
+
+    std::vector<uint32_t> image(static_cast<size_t>(size) * size);
+
+    for (size_t i = 0; i < image.size(); ++i)
+    {
+        image[i] = static_cast<uint32_t>(i * 2654435761u);
+    }
+
+    MipChain tiled;
+    LinearChain linear;
+
+    std::vector<uint32_t> tiledTexels(tiled.Init(size, size)),
+        linearTexels(linear.Init(size, size));
+
+    const auto average = [](uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+    {
+        return static_cast<uint32_t>(((a & 0xFF) + (b & 0xFF) + (c & 0xFF) + (d & 0xFF)) / 4) |
+            (((a >> 8 & 0xFF) + (b >> 8 & 0xFF) + (c >> 8 & 0xFF) + (d >> 8 & 0xFF)) / 4) << 8 |
+            (((a >> 16 & 0xFF) + (b >> 16 & 0xFF) + (c >> 16 & 0xFF) + (d >> 16 & 0xFF)) / 4) << 16;
+    };
+
+    tiled.Fill(tiledTexels, [&image](size_t i) { return image[i]; });
+    tiled.Build(tiledTexels, average);
+
+    std::copy(image.begin(), image.end(), linearTexels.begin());
+
+    for (size_t l = 1; l < linear.levels.size(); ++l)
+    {
+        const MipLevel& src = linear.levels[l - 1],
+            & dst = linear.levels[l];
+
+        for (int y = 0; y < dst.height; ++y)
+        {
+            for (int x = 0; x < dst.width; ++x)
+            {
+                const int x0 = std::min(x * 2, src.width - 1),
+                    x1 = std::min(x * 2 + 1, src.width - 1),
+                    y0 = std::min(y * 2, src.height - 1),
+                    y1 = std::min(y * 2 + 1, src.height - 1);
+
+                linearTexels[linear.Index(l, x, y)] =
+                    average(linearTexels[linear.Index(l - 1, x0, y0)],
+                            linearTexels[linear.Index(l - 1, x1, y0)],
+                            linearTexels[linear.Index(l - 1, x0, y1)],
+                            linearTexels[linear.Index(l - 1, x1, y1)]);
+            }
+        }
+    }
+
+    printf("%dx%d RGBA8 texture, %dx%d samples in 8x8 blocks\n", size, size,
+           screenWidth, screenHeight);
+    printf("Msamples/s, and simulated 32 KB L1 / 1 MB L2 misses per 1000 samples,"
+           " linear / tiled\n");
+    printf("%6s %7s %14s %8s %16s %16s\n", "angle", "texels", "Msamples/s", "speedup",
+           "L1 misses", "L2 misses");
+
+    glm::vec3 sum(0.0f);
+    bool hardware = false;
+
+    for (const float minification : {0.5f, 1.0f, 4.0f})
+    {
+        for (const float angle : {0.0f, 45.0f, 90.0f})
+        {
+            // texels per pixel along each axis
+            const float texelsPerPixel = minification * size / screenWidth;
+
+            const Result a = run(linear, linearTexels, angle, minification, sum),
+                b = run(tiled, tiledTexels, angle, minification, sum);
+
+            printf("%6.0f %7.2f %6.1f / %5.1f %8.2f %7.1f / %6.1f %7.1f / %6.1f\n",
+                   angle, texelsPerPixel, a.msamples, b.msamples, b.msamples / a.msamples,
+                   a.l1Misses, b.l1Misses, a.l2Misses, b.l2Misses);
+
+            if (a.hardwareL1 >= 0.0 && b.hardwareL1 >= 0.0)
+            {
+                printf("%14s hardware L1D %.1f / %.1f, LLC %.1f / %.1f\n", "",
+                       a.hardwareL1, b.hardwareL1, a.hardwareLLC, b.hardwareLLC);
+                hardware = true;
+            }
+        }
+    }
+
+    if (!hardware)
+    {
+        printf("Hardware cache counters unavailable\n");
+    }
+
+    // keeps the samples from being optimized away
+    printf("checksum %g\n", sum.x + sum.y + sum.z);
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "PBRKernel.hpp"
+#include "GammaTable.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+// runs the AVX2 and scalar PBR kernels on the same random packets and
+// checks the tonemapped, gamma encoded results differ by at most 1
+int main()
+{
+    if (!PBRKernel::HasAVX2())
+    {
+        printf("AVX2 not supported, skipped\n");
+        return 0;
+    }
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f), signedUnit(-1.0f, 1.0f);
+
+    const auto randomDirection = [&]()
+    {
+        glm::vec3 d;
+
+        do
+        {
+            d = glm::vec3(signedUnit(rng), signedUnit(rng), signedUnit(rng));
+        }
+        while (glm::dot(d, d) < 0.01f || glm::dot(d, d) > 1.0f);
+
+        return glm::normalize(d);
+    };
+
+    constexpr int packetCount = 100000;
+
+    int maxDiff = 0, failures = 0;
+
+    for (int i = 0; i < packetCount; ++i)
+    {
+        PBRPacket scalar;
+
+        scalar.count = 0;
+
+        // partially filled packets too, as at the end of a tile
+        const int count = i % 4 == 0 ? 1 + i / 4 % PBRPacket::size : PBRPacket::size;
+
+        for (int k = 0; k < count; ++k)
+        {
+            // in front of the camera, which looks down -z
+            const glm::vec3 pos(signedUnit(rng) * 5.0f, signedUnit(rng) * 5.0f,
+                                -0.5f - unit(rng) * 20.0f);
+            const glm::vec3 emission = unit(rng) < 0.1f ?
+                glm::vec3(unit(rng), unit(rng), unit(rng)) : glm::vec3(0.0f);
+
+            scalar.Add(k, 0, -pos.z, randomDirection(), pos,
+                       glm::vec3(unit(rng), unit(rng), unit(rng)),
+                       unit(rng), 0.05f + 0.95f * unit(rng), unit(rng), emission);
+        }
+
+        PBRPacket simd = scalar;
+
+        const glm::vec3 lightVecView = randomDirection();
+
+        PBRKernel::ShadeScalar(scalar, lightVecView);
+        PBRKernel::ShadeAVX2(simd, lightVecView);
+
+        for (int k = 0; k < count; ++k)
+        {
+            const float a[3] = {scalar.r[k], scalar.g[k], scalar.b[k]},
+                b[3] = {simd.r[k], simd.g[k], simd.b[k]};
+
+            for (int c = 0; c < 3; ++c)
+            {
+                // the resolve pass tonemap
+                const int diff = std::abs(GammaTable::Encode(a[c] / (a[c] + 1.0f)) -
+                                          GammaTable::Encode(b[c] / (b[c] + 1.0f)));
+
+                if (diff > maxDiff)
+                {
+                    maxDiff = diff;
+                }
+
+                if (diff > 1 && failures++ < 10)
+                {
+                    printf("Packet %d lane %d channel %d: scalar %g, AVX2 %g\n",
+                           i, k, c, a[c], b[c]);
+                }
+            }
+        }
+    }
+
+    printf("%d packets, max difference %d, %d channels over 1\n",
+           packetCount, maxDiff, failures);
+
+    return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}